@@ -1,17 +1,4 @@
-TEMPLATE = app
-TARGET = RetroGrab
-DEPENDPATH += .
-INCLUDEPATH += .
-CONFIG += release
-QT += widgets
-
-include(./VERSION)
-DEFINES+=VERSION=\\\"$$VERSION\\\"
-
-# Input
-HEADERS += src/window.h \
-           src/slider.h
-
-SOURCES += src/main.cpp \
-           src/window.cpp \
-           src/slider.cpp
+TEMPLATE = subdirs
+SUBDIRS = src tests ledreceiver
+tests.depends = src
+ledreceiver.subdir = tools/ledreceiver
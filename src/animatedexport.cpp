@@ -0,0 +1,572 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            animatedexport.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "animatedexport.h"
+#include "postprocess.h"
+
+#include <QFile>
+#include <QImage>
+#include <QRect>
+#include <QThread>
+#include <QtEndian>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+  // Colors are binned at 5 bits per channel
+  const int binCount = 32768;
+  const int paletteSize = 256;
+
+  inline int binOf(const QRgb &rgb)
+  {
+    return ((rgb >> 9) & 0x7c00) | ((rgb >> 6) & 0x03e0) | ((rgb >> 3) & 0x001f);
+  }
+
+  struct Histogram
+  {
+    int begin = 0;
+    int end = 0;
+    QVector<quint32> counts;
+    // Red, green and blue sums per bin, so palette entries are the exact mean
+    // of the colors they stand for
+    QVector<quint64> sums;
+  };
+
+  struct Bin
+  {
+    int bin = 0;
+    quint32 count = 0;
+    quint64 sum[3] = {0, 0, 0};
+  };
+
+  struct Box
+  {
+    int begin = 0;
+    int end = 0;
+    int channel = 0;
+    int range = 0;
+  };
+
+  struct AnimationFrame
+  {
+    int frame = 0;
+    QByteArray indices;
+    QRect rect;
+    int durationMs = 0;
+    QByteArray encoded;
+  };
+
+  struct Animation
+  {
+    QSize size;
+    QVector<QRgb> palette;
+    QVector<AnimationFrame> frames;
+  };
+
+  inline int channelOf(const int &bin, const int &channel)
+  {
+    return (bin >> (10 - (channel * 5))) & 0x1f;
+  }
+
+  void measureBox(const QVector<Bin> &bins, Box &box)
+  {
+    int low[3] = {31, 31, 31};
+    int high[3] = {0, 0, 0};
+    for(int idx = box.begin; idx < box.end; ++idx) {
+      for(int channel = 0; channel < 3; ++channel) {
+        low[channel] = qMin(low[channel], channelOf(bins.at(idx).bin, channel));
+        high[channel] = qMax(high[channel], channelOf(bins.at(idx).bin, channel));
+      }
+    }
+    box.range = -1;
+    for(int channel = 0; channel < 3; ++channel) {
+      if(high[channel] - low[channel] > box.range) {
+        box.range = high[channel] - low[channel];
+        box.channel = channel;
+      }
+    }
+  }
+
+  // Median cut over the occupied bins. Fills the palette and the palette
+  // index of every occupied bin
+  void medianCut(QVector<Bin> &bins, QVector<QRgb> &palette, QVector<uchar> &lookup)
+  {
+    QVector<Box> boxes;
+    Box all;
+    all.end = bins.count();
+    measureBox(bins, all);
+    boxes.append(all);
+    while(boxes.count() < paletteSize) {
+      // Split the box spanning the widest range of a channel
+      int widest = -1;
+      for(int idx = 0; idx < boxes.count(); ++idx) {
+        if(boxes.at(idx).end - boxes.at(idx).begin > 1 &&
+           (widest == -1 || boxes.at(idx).range > boxes.at(widest).range)) {
+          widest = idx;
+        }
+      }
+      if(widest == -1) {
+        break;
+      }
+      Box &box = boxes[widest];
+      const int channel = box.channel;
+      std::sort(bins.begin() + box.begin, bins.begin() + box.end, [channel](const Bin &a, const Bin &b) {
+        return channelOf(a.bin, channel) < channelOf(b.bin, channel);
+      });
+      quint64 population = 0;
+      for(int idx = box.begin; idx < box.end; ++idx) {
+        population += bins.at(idx).count;
+      }
+      // Split at the median pixel, keeping at least one bin on either side
+      int split = box.begin + 1;
+      quint64 below = bins.at(box.begin).count;
+      while(split < box.end - 1 && below * 2 < population) {
+        below += bins.at(split).count;
+        split++;
+      }
+      Box upper;
+      upper.begin = split;
+      upper.end = box.end;
+      box.end = split;
+      measureBox(bins, box);
+      measureBox(bins, upper);
+      boxes.append(upper);
+    }
+    palette.clear();
+    for(const auto &box: boxes) {
+      quint64 count = 0;
+      quint64 sum[3] = {0, 0, 0};
+      for(int idx = box.begin; idx < box.end; ++idx) {
+        count += bins.at(idx).count;
+        for(int channel = 0; channel < 3; ++channel) {
+          sum[channel] += bins.at(idx).sum[channel];
+        }
+        lookup[bins.at(idx).bin] = palette.count();
+      }
+      palette.append(qRgb((sum[0] + (count / 2)) / count, (sum[1] + (count / 2)) / count, (sum[2] + (count / 2)) / count));
+    }
+  }
+
+  // A frame as 32 bit pixels, corrected on the fly if there is a post process
+  QImage exportFrame(const FrameStore &frames, const int &idx, const PostProcess *postProcess)
+  {
+    if(postProcess != nullptr && !postProcess->isIdentity()) {
+      QImage corrected;
+      postProcess->apply(frames.frame(idx), corrected);
+      return corrected;
+    }
+    return frames.frame(idx).convertToFormat(QImage::Format_RGB32);
+  }
+
+  bool prepare(const FrameStore &frames, const QVector<int> &durations, const PostProcess *postProcess,
+               Animation &animation)
+  {
+    animation.size = frames.frameSize();
+    animation.frames.clear();
+    for(int idx = 0; idx < frames.count(); ++idx) {
+      if(durations.value(idx) > 0) {
+        AnimationFrame frame;
+        frame.frame = idx;
+        frame.durationMs = durations.at(idx);
+        animation.frames.append(frame);
+      }
+    }
+    if(animation.frames.isEmpty()) {
+      return false;
+    }
+
+    // Histograms of a few chunks of frames per thread, summed afterwards
+    QVector<Histogram> histograms(qMin(animation.frames.count(), QThread::idealThreadCount() * 4));
+    for(int idx = 0; idx < histograms.count(); ++idx) {
+      histograms[idx].begin = (animation.frames.count() * idx) / histograms.count();
+      histograms[idx].end = (animation.frames.count() * (idx + 1)) / histograms.count();
+    }
+    QtConcurrent::blockingMap(histograms, [&frames, &animation, postProcess](Histogram &histogram) {
+      histogram.counts.fill(0, binCount);
+      histogram.sums.fill(0, binCount * 3);
+      for(int idx = histogram.begin; idx < histogram.end; ++idx) {
+        const QImage image = exportFrame(frames, animation.frames.at(idx).frame, postProcess);
+        for(int y = 0; y < image.height(); ++y) {
+          const QRgb *line = (const QRgb *)image.constScanLine(y);
+          for(int x = 0; x < image.width(); ++x) {
+            const int bin = binOf(line[x]);
+            histogram.counts[bin]++;
+            histogram.sums[(bin * 3)] += qRed(line[x]);
+            histogram.sums[(bin * 3) + 1] += qGreen(line[x]);
+            histogram.sums[(bin * 3) + 2] += qBlue(line[x]);
+          }
+        }
+      }
+    });
+    QVector<Bin> bins;
+    for(int bin = 0; bin < binCount; ++bin) {
+      Bin total;
+      total.bin = bin;
+      for(const auto &histogram: histograms) {
+        total.count += histogram.counts.at(bin);
+        for(int channel = 0; channel < 3; ++channel) {
+          total.sum[channel] += histogram.sums.at((bin * 3) + channel);
+        }
+      }
+      if(total.count > 0) {
+        bins.append(total);
+      }
+    }
+    QVector<uchar> lookup(binCount, 0);
+    medianCut(bins, animation.palette, lookup);
+
+    // Map every frame to palette indices, then find what changed since the
+    // frame before it
+    QtConcurrent::blockingMap(animation.frames, [&frames, &lookup, postProcess](AnimationFrame &frame) {
+      const QImage image = exportFrame(frames, frame.frame, postProcess);
+      frame.indices.resize(image.width() * image.height());
+      uchar *dst = (uchar *)frame.indices.data();
+      for(int y = 0; y < image.height(); ++y) {
+        const QRgb *line = (const QRgb *)image.constScanLine(y);
+        for(int x = 0; x < image.width(); ++x) {
+          *dst++ = lookup.at(binOf(line[x]));
+        }
+      }
+    });
+    const int width = animation.size.width();
+    const int height = animation.size.height();
+    animation.frames[0].rect = QRect(QPoint(0, 0), animation.size);
+    QVector<int> positions;
+    for(int idx = 1; idx < animation.frames.count(); ++idx) {
+      positions.append(idx);
+    }
+    AnimationFrame *animationFrames = animation.frames.data();
+    QtConcurrent::blockingMap(positions, [animationFrames, width, height](int &position) {
+      AnimationFrame &frame = animationFrames[position];
+      const uchar *previous = (const uchar *)animationFrames[position - 1].indices.constData();
+      const uchar *current = (const uchar *)frame.indices.constData();
+      int left = width;
+      int right = -1;
+      int top = height;
+      int bottom = -1;
+      for(int y = 0; y < height; ++y) {
+        const int offset = y * width;
+        if(memcmp(previous + offset, current + offset, width) == 0) {
+          continue;
+        }
+        top = qMin(top, y);
+        bottom = y;
+        for(int x = 0; x < width; ++x) {
+          if(previous[offset + x] != current[offset + x]) {
+            left = qMin(left, x);
+            right = qMax(right, x);
+          }
+        }
+      }
+      frame.rect = bottom < 0?QRect():QRect(QPoint(left, top), QPoint(right, bottom));
+    });
+
+    // Unchanged frames only extend the delay of the frame before them
+    QVector<AnimationFrame> changed;
+    for(auto &frame: animation.frames) {
+      if(!changed.isEmpty() && frame.rect.isEmpty()) {
+        changed.last().durationMs += frame.durationMs;
+      } else {
+        changed.append(frame);
+      }
+    }
+    animation.frames = changed;
+    return true;
+  }
+
+  // The changed rectangle of a frame, row by row, optionally with a PNG
+  // filter type byte in front of every row
+  QByteArray rectIndices(const Animation &animation, const AnimationFrame &frame, const bool &filterBytes)
+  {
+    QByteArray data;
+    data.reserve((frame.rect.width() + (filterBytes?1:0)) * frame.rect.height());
+    for(int y = frame.rect.top(); y <= frame.rect.bottom(); ++y) {
+      if(filterBytes) {
+        data.append('\0');
+      }
+      data.append(frame.indices.constData() + (y * animation.size.width()) + frame.rect.left(), frame.rect.width());
+    }
+    return data;
+  }
+
+  const int lzwHashSize = 5003;
+  const int lzwMaxCode = 4096;
+
+  struct LzwWriter
+  {
+    QByteArray &out;
+    quint32 buffer = 0;
+    int bits = 0;
+    int codeSize = 9;
+
+    void write(const int &code)
+    {
+      buffer |= (quint32)code << bits;
+      bits += codeSize;
+      while(bits >= 8) {
+        out.append((char)(buffer & 0xff));
+        buffer >>= 8;
+        bits -= 8;
+      }
+    }
+
+    void flush()
+    {
+      if(bits > 0) {
+        out.append((char)(buffer & 0xff));
+      }
+    }
+  };
+
+  // GIF variant of LZW with a minimum code size of 8 bits. Strings are found
+  // through an open addressing hash of (prefix code, next index)
+  QByteArray lzw(const QByteArray &data)
+  {
+    const int clearCode = 256;
+    const int endCode = 257;
+    QVector<int> keys(lzwHashSize, -1);
+    QVector<int> codes(lzwHashSize);
+    QByteArray out;
+    LzwWriter writer{out};
+    writer.write(clearCode);
+    int nextCode = endCode + 1;
+    int prefix = (uchar)data.at(0);
+    for(int idx = 1; idx < data.size(); ++idx) {
+      const int value = (uchar)data.at(idx);
+      const int key = (value << 12) | prefix;
+      int slot = (value << 4) ^ prefix;
+      const int step = slot == 0?1:lzwHashSize - slot;
+      while(keys.at(slot) != -1 && keys.at(slot) != key) {
+        slot -= step;
+        if(slot < 0) {
+          slot += lzwHashSize;
+        }
+      }
+      if(keys.at(slot) == key) {
+        prefix = codes.at(slot);
+        continue;
+      }
+      writer.write(prefix);
+      if(nextCode < lzwMaxCode) {
+        keys[slot] = key;
+        codes[slot] = nextCode++;
+        // The decoder widens its codes one string later than the encoder
+        // adds them, hence the '>'
+        if(nextCode > (1 << writer.codeSize) && writer.codeSize < 12) {
+          writer.codeSize++;
+        }
+      } else {
+        writer.write(clearCode);
+        keys.fill(-1);
+        nextCode = endCode + 1;
+        writer.codeSize = 9;
+      }
+      prefix = value;
+    }
+    writer.write(prefix);
+    writer.write(endCode);
+    writer.flush();
+    // Packed into sub-blocks of at most 255 bytes
+    QByteArray blocks;
+    blocks.reserve(out.size() + (out.size() / 255) + 3);
+    blocks.append((char)8);
+    for(int offset = 0; offset < out.size(); offset += 255) {
+      const int length = qMin(255, out.size() - offset);
+      blocks.append((char)length);
+      blocks.append(out.constData() + offset, length);
+    }
+    blocks.append('\0');
+    return blocks;
+  }
+
+  template<typename T>
+  void putLittle(QByteArray &data, const T &value)
+  {
+    uchar bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    data.append((const char *)bytes, sizeof(T));
+  }
+
+  template<typename T>
+  void putBig(QByteArray &data, const T &value)
+  {
+    uchar bytes[sizeof(T)];
+    qToBigEndian<T>(value, bytes);
+    data.append((const char *)bytes, sizeof(T));
+  }
+
+  quint32 crc32(const QByteArray &data)
+  {
+    static const QVector<quint32> table = []() {
+      QVector<quint32> values(256);
+      for(quint32 idx = 0; idx < 256; ++idx) {
+        quint32 value = idx;
+        for(int bit = 0; bit < 8; ++bit) {
+          value = (value & 1)?(0xedb88320u ^ (value >> 1)):(value >> 1);
+        }
+        values[idx] = value;
+      }
+      return values;
+    }();
+    quint32 crc = 0xffffffffu;
+    for(const char byte: data) {
+      crc = table.at((crc ^ (uchar)byte) & 0xff) ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+  }
+
+  void putChunk(QByteArray &png, const char *type, const QByteArray &content)
+  {
+    putBig<quint32>(png, content.size());
+    const QByteArray typed = QByteArray(type, 4) + content;
+    png.append(typed);
+    putBig<quint32>(png, crc32(typed));
+  }
+
+  bool write(const QString &fileName, const QByteArray &data)
+  {
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)) {
+      return false;
+    }
+    return file.write(data) == data.size();
+  }
+}
+
+bool AnimatedExport::saveGif(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                             const PostProcess *postProcess)
+{
+  Animation animation;
+  if(frames.isEmpty() || !prepare(frames, durations, postProcess, animation)) {
+    return false;
+  }
+  QtConcurrent::blockingMap(animation.frames, [&animation](AnimationFrame &frame) {
+    frame.encoded = lzw(rectIndices(animation, frame, false));
+  });
+
+  QByteArray gif("GIF89a");
+  putLittle<quint16>(gif, animation.size.width());
+  putLittle<quint16>(gif, animation.size.height());
+  // Global color table of 256 entries, 8 bit color resolution
+  gif.append((char)0xf7);
+  gif.append('\0');
+  gif.append('\0');
+  for(int idx = 0; idx < paletteSize; ++idx) {
+    const QRgb color = animation.palette.value(idx, qRgb(0, 0, 0));
+    gif.append((char)qRed(color));
+    gif.append((char)qGreen(color));
+    gif.append((char)qBlue(color));
+  }
+  // Loop forever
+  gif.append("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+  // Delays are in hundredths of a second, rounded on the running total so
+  // the animation doesn't drift
+  qint64 elapsedMs = 0;
+  for(const auto &frame: animation.frames) {
+    const int delay = qRound64((elapsedMs + frame.durationMs) / 10.0) - qRound64(elapsedMs / 10.0);
+    elapsedMs += frame.durationMs;
+    // Graphic control extension, frames are left in place for the next one
+    // to draw over
+    gif.append("\x21\xf9\x04\x04", 4);
+    putLittle<quint16>(gif, qMin(delay, 65535));
+    gif.append('\0');
+    gif.append('\0');
+    gif.append((char)0x2c);
+    putLittle<quint16>(gif, frame.rect.x());
+    putLittle<quint16>(gif, frame.rect.y());
+    putLittle<quint16>(gif, frame.rect.width());
+    putLittle<quint16>(gif, frame.rect.height());
+    gif.append('\0');
+    gif.append(frame.encoded);
+  }
+  gif.append((char)0x3b);
+  return write(fileName, gif);
+}
+
+bool AnimatedExport::saveApng(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                              const PostProcess *postProcess)
+{
+  Animation animation;
+  if(frames.isEmpty() || !prepare(frames, durations, postProcess, animation)) {
+    return false;
+  }
+  QtConcurrent::blockingMap(animation.frames, [&animation](AnimationFrame &frame) {
+    // qCompress() puts the uncompressed size in front of the zlib stream
+    frame.encoded = qCompress(rectIndices(animation, frame, true)).mid(4);
+  });
+
+  QByteArray png("\x89PNG\r\n\x1a\n", 8);
+  QByteArray header;
+  putBig<quint32>(header, animation.size.width());
+  putBig<quint32>(header, animation.size.height());
+  // 8 bit palette indices, default compression, filter and no interlacing
+  header.append("\x08\x03\x00\x00\x00", 5);
+  putChunk(png, "IHDR", header);
+  QByteArray palette;
+  for(const auto &color: animation.palette) {
+    palette.append((char)qRed(color));
+    palette.append((char)qGreen(color));
+    palette.append((char)qBlue(color));
+  }
+  putChunk(png, "PLTE", palette);
+  QByteArray control;
+  putBig<quint32>(control, animation.frames.count());
+  putBig<quint32>(control, 0);
+  putChunk(png, "acTL", control);
+  // Frame controls and frame data share one sequence
+  quint32 sequence = 0;
+  for(int idx = 0; idx < animation.frames.count(); ++idx) {
+    const AnimationFrame &frame = animation.frames.at(idx);
+    QByteArray frameControl;
+    putBig<quint32>(frameControl, sequence++);
+    putBig<quint32>(frameControl, frame.rect.width());
+    putBig<quint32>(frameControl, frame.rect.height());
+    putBig<quint32>(frameControl, frame.rect.x());
+    putBig<quint32>(frameControl, frame.rect.y());
+    // Milliseconds, or hundredths of a second for very long frames
+    const bool isLong = frame.durationMs > 65535;
+    putBig<quint16>(frameControl, isLong?qMin(frame.durationMs / 10, 65535):frame.durationMs);
+    putBig<quint16>(frameControl, isLong?100:1000);
+    // No disposal, frames replace the pixels they cover
+    frameControl.append('\0');
+    frameControl.append('\0');
+    putChunk(png, "fcTL", frameControl);
+    // The first frame covers the whole image and doubles as the still image
+    if(idx == 0) {
+      putChunk(png, "IDAT", frame.encoded);
+    } else {
+      QByteArray frameData;
+      putBig<quint32>(frameData, sequence++);
+      frameData.append(frame.encoded);
+      putChunk(png, "fdAT", frameData);
+    }
+  }
+  putChunk(png, "IEND", QByteArray());
+  return write(fileName, png);
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            animatedexport.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __ANIMATEDEXPORT_H__
+#define __ANIMATEDEXPORT_H__
+
+#include "framestore.h"
+
+#include <QString>
+#include <QVector>
+
+class PostProcess;
+
+// Animated GIF and APNG export for players that don't read RGLA. All frames
+// share one palette of at most 256 colors, found by median cut over a color
+// histogram of the whole animation. After the first frame only the rectangle
+// that changed since the previous frame is written, and a frame identical to
+// the previous one only extends its delay. Histogram, indexing and encoding
+// run in parallel over the frames
+namespace AnimatedExport
+{
+  // Frames with a duration of 0 are left out. With a post process each frame
+  // is corrected as it is read, the store is left as is
+  bool saveGif(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+               const PostProcess *postProcess = nullptr);
+  bool saveApng(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                const PostProcess *postProcess = nullptr);
+}
+
+#endif // __ANIMATEDEXPORT_H__
@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            backbuffer.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "backbuffer.h"
+
+BackBuffer::BackBuffer(const int &capacity)
+{
+  ring.resize(qMax(1, capacity));
+}
+
+BackBuffer::~BackBuffer()
+{
+}
+
+void BackBuffer::resize(const int &capacity)
+{
+  if(capacity < 1 || capacity == ring.size()) {
+    return;
+  }
+  // Keep the newest frames so capture can carry on without a gap
+  QVector<BackBufferSlot> resized(capacity);
+  int keep = qMin(used, capacity);
+  for(int a = 0; a < keep; ++a) {
+    resized[a] = ring.at((start + used - keep + a) % ring.size());
+  }
+  ring = resized;
+  start = 0;
+  used = keep;
+}
+
+void BackBuffer::clear()
+{
+  start = 0;
+  used = 0;
+}
+
+BackBufferSlot &BackBuffer::push(const QSize &size, const QImage::Format &format,
+                                 const QPoint &cursor, const qint64 &timestamp)
+{
+  int idx = (start + used) % ring.size();
+  if(used == ring.size()) {
+    start = (start + 1) % ring.size();
+  } else {
+    used++;
+  }
+  BackBufferSlot &slot = ring[idx];
+  // Only reallocate if the geometry changed or a consumer still holds a
+  // reference to the pixels from the last time the slot was used
+  if(slot.image.size() != size ||
+     slot.image.format() != format ||
+     !slot.image.isDetached()) {
+    slot.image = QImage(size, format);
+  }
+  slot.cursor = cursor;
+  slot.motion = QPoint();
+  slot.timestamp = timestamp;
+  return slot;
+}
+
+BackBufferSlot &BackBuffer::repeat(const QPoint &cursor, const qint64 &timestamp)
+{
+  const BackBufferSlot &newest = this->newest();
+  const int idx = (start + used) % ring.size();
+  if(&ring.at(idx) != &newest) {
+    ring[idx] = newest;
+  }
+  if(used == ring.size()) {
+    start = (start + 1) % ring.size();
+  } else {
+    used++;
+  }
+  BackBufferSlot &slot = ring[idx];
+  slot.cursor = cursor;
+  slot.motion = QPoint();
+  slot.timestamp = timestamp;
+  return slot;
+}
+
+int BackBuffer::count() const
+{
+  return used;
+}
+
+int BackBuffer::capacity() const
+{
+  return ring.size();
+}
+
+bool BackBuffer::isFull() const
+{
+  return used == ring.size();
+}
+
+const BackBufferSlot &BackBuffer::at(const int &idx) const
+{
+  return ring.at((start + idx) % ring.size());
+}
+
+const BackBufferSlot &BackBuffer::oldest() const
+{
+  return at(0);
+}
+
+const BackBufferSlot &BackBuffer::newest() const
+{
+  return at(used - 1);
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            backbuffer.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __BACKBUFFER_H__
+#define __BACKBUFFER_H__
+
+#include <QImage>
+#include <QPoint>
+#include <QVector>
+
+struct BackBufferSlot
+{
+  QImage image;
+  // Position of the image within the viewport it was cut from
+  QPoint offset;
+  // Desktop position of the top left corner of the viewport
+  QPoint origin;
+  QPoint cursor;
+  // How far the content moved since the previous frame, in viewport pixels
+  QPoint motion;
+  qint64 timestamp = 0;
+};
+
+// Fixed capacity ring of look-ahead frames. Slots are recycled in place so
+// their pixel storage is reused once the ring has filled up
+class BackBuffer
+{
+public:
+  BackBuffer(const int &capacity = 1);
+  ~BackBuffer();
+  void resize(const int &capacity);
+  void clear();
+  // Returns the recycled slot, ready to have the new frame rendered into it
+  BackBufferSlot &push(const QSize &size, const QImage::Format &format,
+                       const QPoint &cursor, const qint64 &timestamp);
+  // Pushes the newest frame again, sharing its pixels, for ticks where
+  // nothing changed. Needs at least one frame in the ring
+  BackBufferSlot &repeat(const QPoint &cursor, const qint64 &timestamp);
+  int count() const;
+  int capacity() const;
+  bool isFull() const;
+  const BackBufferSlot &at(const int &idx) const;
+  const BackBufferSlot &oldest() const;
+  const BackBufferSlot &newest() const;
+
+private:
+  QVector<BackBufferSlot> ring;
+  int start = 0;
+  int used = 0;
+
+};
+
+#endif // __BACKBUFFER_H__
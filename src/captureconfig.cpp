@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            captureconfig.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "captureconfig.h"
+
+#include <stdio.h>
+#include <QRegularExpression>
+
+void CaptureConfig::load(QSettings &settings)
+{
+  viewportWidth = settings.value("viewport/width", viewportWidth).toInt();
+  viewportHeight = settings.value("viewport/height", viewportHeight).toInt();
+  divider = settings.value("viewport/divider", divider).toInt();
+  snapAlignmentX = settings.value("viewport/snapAlignmentX", snapAlignmentX).toInt();
+  snapAlignmentY = settings.value("viewport/snapAlignmentY", snapAlignmentY).toInt();
+  fps = settings.value("viewport/fps", fps).toInt();
+  captureSource = settings.value("capture/source", captureSource).toString();
+  grabWidth = settings.value("grab/width", grabWidth).toInt();
+  grabHeight = settings.value("grab/height", grabHeight).toInt();
+  // Unquoted commas in an ini file turn the value into a string list
+  if(!parseRegions(settings.value("grab/regions", "").toStringList().join(','), regions)) {
+    printf("Ignoring malformed 'grab/regions' setting\n");
+    regions.clear();
+  }
+  backBuffer = settings.value("grab/backBuffer", backBuffer).toInt();
+  downscaleMode = Downscale::modeFromName(settings.value("grab/downscale", "nearest").toString());
+  motionCompensation = settings.value("grab/motion", motionCompensation).toBool();
+  motionSearch = qBound(1, settings.value("grab/motionSearch", motionSearch).toInt(), 32);
+  roiCapture = settings.value("grab/roi", roiCapture).toBool();
+  roiMargin = settings.value("grab/roiMargin", roiMargin).toInt();
+  previewFps = settings.value("viewport/previewFps", previewFps).toInt();
+  gridDetection = settings.value("viewport/detectGrid", gridDetection).toBool();
+  adaptiveCapture = settings.value("grab/adaptive", adaptiveCapture).toBool();
+  idleFps = qMax(1, settings.value("grab/idleFps", idleFps).toInt());
+  gamma = qBound(1, settings.value("post/gamma", gamma).toInt(), 40);
+  brightness = qBound(1, settings.value("post/brightness", brightness).toInt(), 100);
+  colorDepth = settings.value("post/depth", colorDepth).toString();
+  const QString ditherName = settings.value("post/dither", "none").toString();
+  dither = ditherName == "ordered"?OrderedDither:ditherName == "floyd-steinberg"?FloydSteinberg:NoDither;
+  streamEnabled = settings.value("stream/enabled", streamEnabled).toBool();
+  streamProtocol = settings.value("stream/protocol", "ddp").toString() == "e131"?E131:Ddp;
+  streamHost = settings.value("stream/host", streamHost).toString();
+  streamPort = settings.value("stream/port", streamProtocol == E131?5568:4048).toInt();
+  streamUniverse = settings.value("stream/universe", streamUniverse).toInt();
+  streamTimecode = settings.value("stream/timecode", streamTimecode).toBool();
+}
+
+bool CaptureConfig::parseRegions(const QString &value, QVector<CaptureRegion> &regions)
+{
+  // Names end up in file and directory names of the export
+  static const QRegularExpression entryPattern("^([A-Za-z0-9_-]+)=(@?)(-?\\d+),(-?\\d+),(\\d+),(\\d+)$");
+  regions.clear();
+  for(const auto &entry: value.split(';')) {
+    if(entry.trimmed().isEmpty()) {
+      continue;
+    }
+    const QRegularExpressionMatch match = entryPattern.match(entry.trimmed());
+    if(!match.hasMatch()) {
+      return false;
+    }
+    CaptureRegion region;
+    region.name = match.captured(1);
+    region.fixed = !match.captured(2).isEmpty();
+    region.offset = QPoint(match.captured(3).toInt(), match.captured(4).toInt());
+    region.size = QSize(match.captured(5).toInt(), match.captured(6).toInt());
+    if(region.size.isEmpty()) {
+      return false;
+    }
+    for(const auto &other: regions) {
+      if(other.name == region.name) {
+        return false;
+      }
+    }
+    regions.append(region);
+  }
+  return true;
+}
+
+CaptureConfigStore::CaptureConfigStore(const CaptureConfig &config)
+  : pending(config), published(std::make_shared<const CaptureConfig>(config))
+{
+}
+
+CaptureConfigStore::~CaptureConfigStore()
+{
+}
+
+CaptureConfig &CaptureConfigStore::edit()
+{
+  return pending;
+}
+
+const CaptureConfig &CaptureConfigStore::current() const
+{
+  return pending;
+}
+
+void CaptureConfigStore::publish()
+{
+  // The copy is made and the old snapshot released outside the lock
+  std::shared_ptr<const CaptureConfig> updated = std::make_shared<const CaptureConfig>(pending);
+  QMutexLocker locker(&publishedMutex);
+  published.swap(updated);
+}
+
+std::shared_ptr<const CaptureConfig> CaptureConfigStore::snapshot() const
+{
+  QMutexLocker locker(&publishedMutex);
+  return published;
+}
@@ -0,0 +1,132 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            captureconfig.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __CAPTURECONFIG_H__
+#define __CAPTURECONFIG_H__
+
+#include "downscale.h"
+
+#include <QSettings>
+#include <QMutex>
+#include <QString>
+#include <QPoint>
+#include <QSize>
+#include <QVector>
+
+#include <memory>
+
+// An extra area cut from the same grab as the main grab rectangle, for
+// instance one panel of a tiled LED wall
+struct CaptureRegion
+{
+  QString name;
+  // Offset of the top left corner from that of the grab rectangle, in frame
+  // pixels. Fixed regions stay put on the desktop instead and the offset is
+  // the desktop position
+  QPoint offset;
+  QSize size;
+  bool fixed = false;
+};
+
+struct CaptureConfig
+{
+  enum StreamProtocol {
+    Ddp,
+    E131
+  };
+  enum Dither {
+    NoDither,
+    OrderedDither,
+    FloydSteinberg
+  };
+  void load(QSettings &settings);
+  // 'name=x,y,width,height' entries separated by ';'. A '@' in front of x
+  // fixes the region to the desktop. Returns false on a malformed list
+  static bool parseRegions(const QString &value, QVector<CaptureRegion> &regions);
+
+  int viewportWidth = 128;
+  int viewportHeight = 128;
+  int divider = 1;
+  int snapAlignmentX = 1;
+  int snapAlignmentY = 1;
+  int fps = 30;
+  QString captureSource = "auto";
+  int grabWidth = 16;
+  int grabHeight = 16;
+  QVector<CaptureRegion> regions;
+  int backBuffer = 5;
+  Downscale::Mode downscaleMode = Downscale::Nearest;
+  bool motionCompensation = false;
+  int motionSearch = 8;
+  bool roiCapture = false;
+  int roiMargin = 16;
+  int previewFps = 10;
+  // Look for the pixel grid of the content every few frames
+  bool gridDetection = false;
+  // Back off to probing the recorded area at idleFps while nothing changes
+  bool adaptiveCapture = false;
+  int idleFps = 4;
+  // Panel correction of streamed and exported frames, see PostProcess.
+  // Gamma is in tenths, brightness in percent and the color depth gives the
+  // bits per channel as digits, like '565'
+  int gamma = 10;
+  int brightness = 100;
+  QString colorDepth = "888";
+  Dither dither = NoDither;
+  bool streamEnabled = false;
+  StreamProtocol streamProtocol = Ddp;
+  QString streamHost = "127.0.0.1";
+  int streamPort = 4048;
+  int streamUniverse = 1;
+  bool streamTimecode = false;
+  bool mouseSnap = true;
+  bool lockX = false;
+  bool lockY = false;
+  int lockPosX = -1;
+  int lockPosY = -1;
+};
+
+// The GUI thread edits its own copy and publishes it as an immutable snapshot.
+// The capture thread picks up the latest snapshot once per tick. Only the
+// pointer swap and copy happen under the lock
+class CaptureConfigStore
+{
+public:
+  CaptureConfigStore(const CaptureConfig &config = CaptureConfig());
+  ~CaptureConfigStore();
+  CaptureConfig &edit();
+  const CaptureConfig &current() const;
+  void publish();
+  std::shared_ptr<const CaptureConfig> snapshot() const;
+
+private:
+  CaptureConfig pending;
+  mutable QMutex publishedMutex;
+  std::shared_ptr<const CaptureConfig> published;
+
+};
+
+#endif // __CAPTURECONFIG_H__
@@ -0,0 +1,337 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            capturepipeline.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "capturepipeline.h"
+#include "downscale.h"
+#include "profiler.h"
+
+#include <QPainter>
+#include <QtMath>
+
+CapturePipeline::CapturePipeline()
+{
+}
+
+CapturePipeline::~CapturePipeline()
+{
+  qDeleteAll(sources);
+}
+
+qint64 CapturePipeline::motionEstimateNsecs() const
+{
+  return motionNsecs;
+}
+
+void CapturePipeline::requestGridDetection()
+{
+  gridPending = true;
+}
+
+CaptureSource *CapturePipeline::sourceFor(const ScreenInfo &screen, const QString &sourceName)
+{
+  if(sourceName != this->sourceName) {
+    qDeleteAll(sources);
+    sources.clear();
+    this->sourceName = sourceName;
+  }
+  CaptureSource *source = sources.value(screen.name, nullptr);
+  if(source == nullptr) {
+    source = CaptureSource::create(sourceName, screen);
+    sources.insert(screen.name, source);
+  }
+  return source;
+}
+
+QRect CapturePipeline::regionRect(const CaptureRegion &region, const QPoint &grabTopLeft, const QPoint &viewportOrigin,
+                                  const int &divider) const
+{
+  if(!region.fixed) {
+    return QRect(grabTopLeft + region.offset, region.size);
+  }
+  const QPoint desktopOffset = region.offset - viewportOrigin;
+  return QRect(qFloor(desktopOffset.x() / (double)divider), qFloor(desktopOffset.y() / (double)divider),
+               region.size.width(), region.size.height());
+}
+
+bool CapturePipeline::sampleArea(const QImage &image, const QPoint &topLeft, const QSize &area, const int &divider,
+                                 QVector<QRgb> &samples) const
+{
+  if(area.isEmpty() || !image.rect().contains(QRect(topLeft, area * divider))) {
+    return false;
+  }
+  samples.resize(area.width() * area.height());
+  QRgb *sample = samples.data();
+  const int center = divider / 2;
+  for(int y = 0; y < area.height(); ++y) {
+    const int line = topLeft.y() + (y * divider) + center;
+    if(image.depth() == 32) {
+      const QRgb *src = (const QRgb *)image.constScanLine(line) + topLeft.x() + center;
+      for(int x = 0; x < area.width(); ++x) {
+        *sample++ = src[x * divider];
+      }
+    } else {
+      for(int x = 0; x < area.width(); ++x) {
+        *sample++ = image.pixel(topLeft.x() + (x * divider) + center, line);
+      }
+    }
+  }
+  return true;
+}
+
+bool CapturePipeline::run(const CaptureConfig &config, const QPoint &cursor, const ScreenInfo &screen,
+                          const QElapsedTimer &clock, const bool &recording, const bool &previewing,
+                          CaptureTick &result)
+{
+  const QPoint &pos = cursor;
+  const int viewportWidth = config.viewportWidth;
+  const int viewportHeight = config.viewportHeight;
+  const int grabWidth = config.grabWidth;
+  const int grabHeight = config.grabHeight;
+  const double scaleDivider = config.divider;
+  const int snapAlignmentX = config.snapAlignmentX;
+  const int snapAlignmentY = config.snapAlignmentY;
+  const bool mouseSnap = config.mouseSnap;
+
+  // While recording in region-of-interest mode only the grab rectangle plus a
+  // margin covering the expected look-ahead cursor travel is captured. The
+  // full viewport is still grabbed now and then to keep the preview alive
+  const int previewInterval = qMax(1, config.fps / qMax(1, config.previewFps));
+  const bool fullTick = !recording || !config.roiCapture || (previewing && tick % previewInterval == 0);
+  tick++;
+  const int originX = snapAlignmentX + (pos.x() - (mouseSnap?pos.x() % (int)scaleDivider:0)) - ((viewportWidth * scaleDivider) / 2.0);
+  const int originY = snapAlignmentY + (pos.y() - (mouseSnap?pos.y() % (int)scaleDivider:0)) - ((viewportHeight * scaleDivider) / 2.0);
+  const QRect viewportRect(0, 0, viewportWidth, viewportHeight);
+  // Everything that ends up in the recorded frames
+  const QRect grabArea((viewportWidth / 2) - (grabWidth / 2), (viewportHeight / 2) - (grabHeight / 2),
+                       grabWidth, grabHeight);
+  QRect area = grabArea;
+  for(const auto &region: config.regions) {
+    area |= regionRect(region, grabArea.topLeft(), QPoint(originX, originY), config.divider);
+  }
+  area = area.intersected(viewportRect);
+  QRect captureRect = viewportRect;
+  if(!fullTick) {
+    // Rounded up to steps of 8 pixels, and only shrunk once the travel has
+    // dropped well below, so the region keeps its size from tick to tick and
+    // the back buffer slots are recycled instead of reallocated
+    const int wanted = config.roiMargin + qCeil(travelPeak * 1.5);
+    if(wanted > roiMargin || wanted + 16 <= roiMargin) {
+      roiMargin = ((wanted + 7) / 8) * 8;
+    }
+    captureRect = area.adjusted(-roiMargin, -roiMargin, roiMargin, roiMargin).intersected(viewportRect);
+  }
+
+  CaptureSource *source = sourceFor(screen, config.captureSource);
+  backBuffer.resize(config.backBuffer);
+
+  // Adaptive capture. Once the recorded area has stayed the same for a second
+  // only a probe of that area is grabbed, at a rate that backs off to
+  // idleFps. Ticks in between push the newest frame again, so the look-ahead
+  // crop keeps running at the full rate. Any change or cursor movement goes
+  // straight back to full capture
+  const QRect desktopProbe(originX + (area.x() * scaleDivider), originY + (area.y() * scaleDivider),
+                           area.width() * scaleDivider, area.height() * scaleDivider);
+  if(!config.adaptiveCapture || pos != probeCursor || desktopProbe != probeRect || backBuffer.count() == 0) {
+    unchangedTicks = 0;
+    idle = false;
+  }
+  probeCursor = pos;
+  probeRect = desktopProbe;
+  // Continuous grid detection runs a few times per second, and not at all
+  // while idle since the content doesn't change then
+  if(config.gridDetection && !idle && tick % qMax(1, config.fps / 4) == 0) {
+    gridPending = true;
+  }
+  bool repeated = false;
+  if(idle && !gridPending) {
+    if(probeCountdown > 0) {
+      probeCountdown--;
+      repeated = true;
+    } else {
+      QImage probe;
+      bool grabbed = false;
+      {
+        ProfileScope scope(Profiler::Grab);
+        grabbed = source->grab(screen, desktopProbe, probe);
+      }
+      if(grabbed &&
+         sampleArea(probe, QPoint(), area.size(), config.divider, probeSamples) &&
+         probeSamples == samples) {
+        probeInterval = qMin(probeInterval * 2, qMax(1, config.fps / config.idleFps));
+        probeCountdown = probeInterval - 1;
+        repeated = true;
+      } else {
+        unchangedTicks = 0;
+        idle = false;
+      }
+    }
+  }
+  if(repeated) {
+    ProfileScope scope(Profiler::BackBuffer);
+    backBuffer.repeat(pos, clock.nsecsElapsed());
+  } else {
+    QImage screenGrab;
+    {
+      ProfileScope scope(Profiler::Grab);
+      if(!source->grab(screen,
+                       QRect(originX + (captureRect.x() * scaleDivider),
+                             originY + (captureRect.y() * scaleDivider),
+                             captureRect.width() * scaleDivider,
+                             captureRect.height() * scaleDivider),
+                       screenGrab)) {
+        return false;
+      }
+    }
+    BackBufferSlot *pushed = nullptr;
+    {
+      ProfileScope scope(Profiler::BackBuffer);
+      pushed = &backBuffer.push(QSize(captureRect.width(), qRound(screenGrab.height() * (captureRect.width() / (double)screenGrab.width()))),
+                                screenGrab.format(), pos, clock.nsecsElapsed());
+    }
+    BackBufferSlot &slot = *pushed;
+    slot.offset = captureRect.topLeft();
+    slot.origin = QPoint(originX, originY);
+    // Reduce the grab by the integer divider straight into the recycled slot.
+    // Grabs that came back clipped or in a format the kernel doesn't handle are
+    // scaled by QPainter instead
+    {
+      ProfileScope scope(Profiler::Scale);
+      if(screenGrab.size() != captureRect.size() * scaleDivider ||
+         !Downscale::scale(screenGrab, slot.image, config.divider, config.downscaleMode)) {
+        QPainter painter(&slot.image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(slot.image.rect(), screenGrab);
+        painter.end();
+      }
+    }
+
+    // On the unscaled grab, the scaled frame has lost the grid already
+    if(gridPending) {
+      gridPending = false;
+      result.hasGrid = true;
+      PixelGrid &grid = result.grid;
+      gridDetector.detect(screenGrab, grid);
+      const int grabX = originX + (captureRect.x() * scaleDivider);
+      const int grabY = originY + (captureRect.y() * scaleDivider);
+      grid.phaseX = (((grabX + grid.phaseX) % grid.scale) + grid.scale) % grid.scale;
+      grid.phaseY = (((grabY + grid.phaseY) % grid.scale) + grid.scale) % grid.scale;
+    }
+
+    if(config.adaptiveCapture) {
+      // Sampled exactly like a probe, so an unchanged area compares equal
+      const QPoint topLeft = (area.topLeft() - captureRect.topLeft()) * scaleDivider;
+      if(screenGrab.size() == captureRect.size() * scaleDivider &&
+         sampleArea(screenGrab, topLeft, area.size(), config.divider, probeSamples) &&
+         probeSamples == samples) {
+        unchangedTicks++;
+        if(unchangedTicks >= config.fps) {
+          idle = true;
+          probeInterval = 1;
+          probeCountdown = 0;
+        }
+      } else {
+        unchangedTicks = 0;
+      }
+      samples.swap(probeSamples);
+    }
+
+    if(config.motionCompensation && backBuffer.count() > 1) {
+      ProfileScope scope(Profiler::Motion);
+      const BackBufferSlot &previous = backBuffer.at(backBuffer.count() - 2);
+      // Match a block around the grab area, big enough to carry some texture
+      // and small enough to stay cheap
+      const int regionWidth = qBound(16, grabWidth, 64);
+      const int regionHeight = qBound(16, grabHeight, 64);
+      const QRect region((viewportWidth / 2) - (regionWidth / 2), (viewportHeight / 2) - (regionHeight / 2),
+                         regionWidth, regionHeight);
+      if(!motionEstimator.estimate(previous, slot, region, config.motionSearch, slot.motion)) {
+        // The viewport follows the cursor, so static content moves against it
+        slot.motion = QPoint(-qFloor((pos.x() - previous.cursor.x()) / scaleDivider),
+                             -qFloor((pos.y() - previous.cursor.y()) / scaleDivider));
+      }
+      motionNsecs = motionEstimator.lastNsecs();
+    }
+  }
+
+  if(fullTick && previewing && !repeated) {
+    result.hasPreview = true;
+    result.preview = {backBuffer.newest().image, pos, backBuffer.newest().timestamp, {}};
+  }
+
+  cropOldest(config, pos, recording, result);
+  return true;
+}
+
+void CapturePipeline::cropOldest(const CaptureConfig &config, const QPoint &cursor, const bool &recording,
+                                 CaptureTick &result)
+{
+  if(!backBuffer.isFull()) {
+    return;
+  }
+  const QPoint &pos = cursor;
+  const int viewportWidth = config.viewportWidth;
+  const int viewportHeight = config.viewportHeight;
+  const int grabWidth = config.grabWidth;
+  const int grabHeight = config.grabHeight;
+  const double scaleDivider = config.divider;
+  const BackBufferSlot &oldest = backBuffer.oldest();
+  QPoint travel(qFloor((pos.x() - oldest.cursor.x()) / scaleDivider),
+                qFloor((pos.y() - oldest.cursor.y()) / scaleDivider));
+  if(config.motionCompensation) {
+    // The content that is at the center now sat where the summed motion
+    // since the oldest frame points back to
+    travel = QPoint();
+    for(int idx = 1; idx < backBuffer.count(); ++idx) {
+      travel -= backBuffer.at(idx).motion;
+    }
+  }
+  travelPeak = qMax((double)qMax(qAbs(travel.x()), qAbs(travel.y())), travelPeak * 0.99);
+  if(recording || config.streamEnabled) {
+    QRect grabRect(((viewportWidth / 2) - (grabWidth / 2)) + travel.x(),
+                   ((viewportHeight / 2) - (grabHeight / 2)) + travel.y(),
+                   grabWidth,
+                   grabHeight);
+    // The buffered frame may only cover part of the viewport
+    grabRect.translate(-oldest.offset);
+    // QImage::copy() pads out-of-bounds areas instead of clipping, so check
+    // that the look-ahead crop lies fully inside the buffered frame
+    if(oldest.image.rect().contains(grabRect)) {
+      ProfileScope scope(Profiler::Crop);
+      // Stamped with the time the cropped frame was grabbed
+      result.hasCrop = true;
+      result.crop = {oldest.image.copy(grabRect), pos, oldest.timestamp, {}};
+      // The regions come from the same buffered frame, so all of them show
+      // the same moment. Parts outside of it are padded with black
+      for(const auto &region: config.regions) {
+        const QRect rect = regionRect(region, grabRect.topLeft() + oldest.offset, oldest.origin, config.divider);
+        result.crop.regions.append(oldest.image.copy(rect.translated(-oldest.offset)));
+      }
+    } else {
+      // Travelled further than the region of interest covered
+      result.missedCrop = true;
+    }
+  }
+}
@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            capturepipeline.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __CAPTUREPIPELINE_H__
+#define __CAPTUREPIPELINE_H__
+
+#include "backbuffer.h"
+#include "captureconfig.h"
+#include "capturesource.h"
+#include "motionestimator.h"
+#include "griddetector.h"
+
+#include <QImage>
+#include <QPoint>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+
+struct CapturedFrame
+{
+  QImage image;
+  QPoint cursor;
+  // Monotonic nanoseconds since capture started
+  qint64 timestamp = 0;
+  // Cut from the same buffered frame as the image, one per capture region
+  QVector<QImage> regions;
+};
+
+struct CaptureTick
+{
+  // The full viewport was grabbed and should be shown in the preview
+  bool hasPreview = false;
+  CapturedFrame preview;
+  // The look-ahead crop of the oldest buffered frame
+  bool hasCrop = false;
+  CapturedFrame crop;
+  // A crop was due but fell outside the buffered frame
+  bool missedCrop = false;
+  // Result of a grid detection on this tick's grab, phases are in desktop
+  // coordinates
+  bool hasGrid = false;
+  PixelGrid grid;
+};
+
+// The work of a single capture tick: grab, downscale into the back buffer,
+// motion estimation and the look-ahead crop. It has no timers, threads or
+// widgets, so the benchmark can run it on synthetic screens just like the
+// capture worker does on its clock
+class CapturePipeline
+{
+public:
+  CapturePipeline();
+  ~CapturePipeline();
+  // The cursor has any locked axes applied already, and the screen is the one
+  // it is on. The crop is only taken while recording or streaming. Returns
+  // false if the grab failed
+  bool run(const CaptureConfig &config, const QPoint &cursor, const ScreenInfo &screen,
+           const QElapsedTimer &clock, const bool &recording, const bool &previewing, CaptureTick &result);
+  // Time spent on motion estimation for the latest frame
+  qint64 motionEstimateNsecs() const;
+  // Runs grid detection on the next grab, even while adaptive capture idles
+  void requestGridDetection();
+  // The look-ahead crop step of run(), cut from the oldest buffered frame
+  // once the back buffer is full
+  void cropOldest(const CaptureConfig &config, const QPoint &cursor, const bool &recording, CaptureTick &result);
+
+private:
+  CaptureSource *sourceFor(const ScreenInfo &screen, const QString &sourceName);
+  // In viewport pixels, for a grab rectangle and viewport at the given places
+  QRect regionRect(const CaptureRegion &region, const QPoint &grabTopLeft, const QPoint &viewportOrigin,
+                   const int &divider) const;
+  // One sample per frame pixel of the area, taken where the nearest neighbour
+  // downscale would take it. Returns false if the area isn't fully covered
+  bool sampleArea(const QImage &image, const QPoint &topLeft, const QSize &area, const int &divider,
+                  QVector<QRgb> &samples) const;
+  quint64 tick = 0;
+  double travelPeak = 0.0;
+  int roiMargin = 0;
+  BackBuffer backBuffer;
+  MotionEstimator motionEstimator;
+  qint64 motionNsecs = 0;
+  GridDetector gridDetector;
+  bool gridPending = false;
+  // Keyed by screen name, all created for the same source setting
+  QHash<QString, CaptureSource *> sources;
+  QString sourceName;
+  // Adaptive capture state. The probe covers the grab rectangle and regions
+  // in desktop coordinates
+  QVector<QRgb> samples;
+  QVector<QRgb> probeSamples;
+  QRect probeRect;
+  QPoint probeCursor;
+  int unchangedTicks = 0;
+  bool idle = false;
+  int probeInterval = 1;
+  int probeCountdown = 0;
+
+};
+
+#endif // __CAPTUREPIPELINE_H__
@@ -0,0 +1,152 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            capturesource.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "capturesource.h"
+#ifdef RETROGRAB_XSHM
+#include "xshmcapturesource.h"
+#endif
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QPainter>
+#include <QImageReader>
+#include <QSemaphore>
+
+#include <memory>
+#include <stdio.h>
+
+namespace
+{
+  const int grabTimeoutMsecs = 100;
+}
+
+CaptureSource::~CaptureSource()
+{
+}
+
+CaptureSource *CaptureSource::create(const QString &name, const ScreenInfo &screen)
+{
+  if(name == "synthetic") {
+    return new SyntheticCaptureSource();
+  } else if(name.startsWith("file:")) {
+    return new SyntheticCaptureSource(name.mid(5));
+  }
+#ifdef RETROGRAB_XSHM
+  // Shared memory only helps on a local X server, otherwise fall back to Qt
+  if((name == "auto" || name == "xshm") &&
+     QGuiApplication::platformName() == "xcb") {
+    XShmCaptureSource *source = new XShmCaptureSource(screen);
+    if(source->isValid()) {
+      return source;
+    }
+    delete source;
+  }
+#endif
+  Q_UNUSED(screen);
+  return new QtCaptureSource();
+}
+
+bool QtCaptureSource::grab(const ScreenInfo &screen, const QRect &rect, QImage &image)
+{
+  // Shared with the GUI thread, which may still get to it after the wait
+  // below has given up
+  struct Request
+  {
+    QString name;
+    QRect rect;
+    QImage image;
+    QSemaphore done;
+  };
+  std::shared_ptr<Request> request = std::make_shared<Request>();
+  request->name = screen.name;
+  request->rect = rect.translated(-screen.geometry.topLeft());
+  QMetaObject::invokeMethod(qGuiApp, [request]() {
+    for(auto *screen: QGuiApplication::screens()) {
+      if(screen->name() == request->name) {
+        const QRect &local = request->rect;
+        request->image = screen->grabWindow(0, local.x(), local.y(), local.width(), local.height()).toImage();
+        break;
+      }
+    }
+    request->done.release();
+  }, Qt::QueuedConnection);
+  // Bounded, so a GUI thread that is itself waiting for the capture thread,
+  // as when it is stopped, costs a tick instead of a deadlock
+  if(!request->done.tryAcquire(1, grabTimeoutMsecs)) {
+    return false;
+  }
+  image = request->image;
+  return !image.isNull();
+}
+
+SyntheticCaptureSource::SyntheticCaptureSource(const QString &fileName)
+{
+  if(!fileName.isEmpty()) {
+    QImageReader reader(fileName);
+    QImage frame;
+    while(reader.read(&frame)) {
+      frames.append(frame.convertToFormat(QImage::Format_RGB32));
+    }
+    if(frames.isEmpty()) {
+      printf("Could not read '%s' as a capture source: %s\n", qPrintable(fileName), qPrintable(reader.errorString()));
+    }
+  }
+}
+
+bool SyntheticCaptureSource::grab(const ScreenInfo &, const QRect &rect, QImage &image)
+{
+  if(buffer.size() != rect.size()) {
+    buffer = QImage(rect.size(), QImage::Format_RGB32);
+  }
+  if(!frames.isEmpty()) {
+    buffer.fill(Qt::black);
+    QPainter painter(&buffer);
+    painter.drawImage(-rect.topLeft(), frames.at(tick % frames.count()));
+    painter.end();
+  } else {
+    // 8x8 pixel blocks with colors derived from the block position and a
+    // 32x32 white sprite travelling diagonally
+    const int sprite = (tick * 2) % 1024;
+    for(int y = 0; y < rect.height(); ++y) {
+      const int globalY = rect.y() + y;
+      QRgb *line = (QRgb *)buffer.scanLine(y);
+      for(int x = 0; x < rect.width(); ++x) {
+        const int globalX = rect.x() + x;
+        if(globalX >= sprite && globalX < sprite + 32 &&
+           globalY >= sprite && globalY < sprite + 32) {
+          line[x] = qRgb(255, 255, 255);
+        } else {
+          const quint32 block = ((quint32)(globalX >> 3) * 73856093u) ^ ((quint32)(globalY >> 3) * 19349663u);
+          line[x] = qRgb(block & 0xe0, (block >> 8) & 0xe0, (block >> 16) & 0xc0);
+        }
+      }
+    }
+  }
+  tick++;
+  image = buffer;
+  return true;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            capturesource.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __CAPTURESOURCE_H__
+#define __CAPTURESOURCE_H__
+
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+// A screen as sampled on the GUI thread, see CursorTracker. The QScreen
+// itself may be gone by the time the capture thread looks at it, so it is
+// only looked up again by name on the GUI thread
+struct ScreenInfo
+{
+  QString name;
+  QRect geometry;
+};
+
+// Delivers the pixels of a rectangle of the desktop. Sources live in the
+// capture thread and are picked per screen, the rectangle is given in global
+// desktop coordinates. The returned image is only guaranteed to stay valid
+// until the next call to grab()
+class CaptureSource
+{
+public:
+  virtual ~CaptureSource();
+  virtual bool grab(const ScreenInfo &screen, const QRect &rect, QImage &image) = 0;
+  // 'auto', 'qt', 'xshm', 'synthetic' or 'file:<image or animation>'
+  static CaptureSource *create(const QString &name, const ScreenInfo &screen);
+};
+
+// QScreen::grabWindow(), works everywhere but copies into a new pixmap per grab.
+// QScreen may only be used on the GUI thread, so each grab is handed to it and
+// waited for
+class QtCaptureSource : public CaptureSource
+{
+public:
+  bool grab(const ScreenInfo &screen, const QRect &rect, QImage &image) override;
+};
+
+// Deterministic frames for testing the pipeline without a real desktop. Without
+// a file it renders a pixel-art pattern with a sprite that moves two pixels per
+// grab. With a file the frames of the image or animation are shown one per
+// grab, placed at the desktop origin
+class SyntheticCaptureSource : public CaptureSource
+{
+public:
+  SyntheticCaptureSource(const QString &fileName = QString());
+  bool grab(const ScreenInfo &screen, const QRect &rect, QImage &image) override;
+
+private:
+  QVector<QImage> frames;
+  QImage buffer;
+  quint64 tick = 0;
+
+};
+
+#endif // __CAPTURESOURCE_H__
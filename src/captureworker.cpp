@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            captureworker.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "captureworker.h"
+#include "profiler.h"
+
+#include <QThread>
+
+CaptureWorker::CaptureWorker(const CaptureConfigStore &configStore, const CursorTracker &cursorTracker)
+  : configStore(configStore), cursorTracker(cursorTracker)
+{
+}
+
+CaptureWorker::~CaptureWorker()
+{
+}
+
+void CaptureWorker::start()
+{
+  clock.start();
+  fps = configStore.snapshot()->fps;
+  epoch = 0;
+  deadlineIdx = 0;
+  grabTimer.start(0, Qt::PreciseTimer, this);
+}
+
+void CaptureWorker::stop()
+{
+  grabTimer.stop();
+}
+
+void CaptureWorker::setRecording(const bool &recording)
+{
+  this->recording = recording;
+}
+
+void CaptureWorker::setPreview(const bool &preview)
+{
+  this->preview = preview;
+}
+
+void CaptureWorker::acknowledgeFrames()
+{
+  notifyPending = false;
+}
+
+void CaptureWorker::detectGrid()
+{
+  gridRequested = true;
+}
+
+qint64 CaptureWorker::motionEstimateNsecs() const
+{
+  return motionNsecs;
+}
+
+int CaptureWorker::skippedTicks() const
+{
+  return skipped;
+}
+
+void CaptureWorker::resetSkippedTicks()
+{
+  skipped = 0;
+}
+
+qint64 CaptureWorker::deadline(const quint64 &idx) const
+{
+  return epoch + (qint64)((idx * Q_UINT64_C(1000000000)) / fps);
+}
+
+void CaptureWorker::scheduleTick()
+{
+  // Ticks are due at absolute deadlines, so millisecond timer resolution and
+  // late wakeups never add up. The timer fires up to a millisecond early and
+  // the remainder is slept off
+  qint64 now = clock.nsecsElapsed();
+  const qint64 due = deadline(deadlineIdx);
+  if(now < due) {
+    QThread::usleep((due - now) / 1000);
+    now = clock.nsecsElapsed();
+  }
+  deadlineIdx++;
+  if(now >= deadline(deadlineIdx)) {
+    // Too late for the following deadlines as well. Skip them, and count
+    // them, rather than running a burst of ticks to catch up
+    const quint64 current = ((quint64)(now - epoch) * fps) / Q_UINT64_C(1000000000);
+    skipped += current + 1 - deadlineIdx;
+    deadlineIdx = current + 1;
+  }
+  grabTimer.start(qMax(0LL, (deadline(deadlineIdx) - clock.nsecsElapsed()) / 1000000), Qt::PreciseTimer, this);
+}
+
+void CaptureWorker::timerEvent(QTimerEvent *)
+{
+  // One snapshot per tick so every stage sees the same consistent settings
+  const std::shared_ptr<const CaptureConfig> config = configStore.snapshot();
+  if(config->fps != fps) {
+    fps = config->fps;
+    epoch = clock.nsecsElapsed();
+    deadlineIdx = 0;
+  }
+  scheduleTick();
+  // Everything but the wait for the next deadline
+  ProfileScope scope(Profiler::Tick);
+
+  // Sampled on the GUI thread, QCursor and QScreen aren't safe to use here
+  QPoint pos = cursorTracker.position();
+  if(config->lockX) {
+    pos.setX(config->lockPosX);
+  }
+  if(config->lockY) {
+    pos.setY(config->lockPosY);
+  }
+  const ScreenInfo screen = cursorTracker.screenAt(pos);
+  const bool isRecording = recording;
+  if(gridRequested.exchange(false)) {
+    pipeline.requestGridDetection();
+  }
+  CaptureTick result;
+  if(!pipeline.run(*config, pos, screen, clock, isRecording, preview, result)) {
+    return;
+  }
+  motionNsecs = pipeline.motionEstimateNsecs();
+  if(result.missedCrop && isRecording) {
+    skipped++;
+  }
+  if(result.hasGrid) {
+    gridQueue.push(std::move(result.grid));
+  }
+  if(result.hasPreview) {
+    previewQueue.push(std::move(result.preview));
+  }
+  if(result.hasCrop) {
+    // Streamed straight from the capture tick so the panel follows the
+    // capture clock
+    if(config->streamEnabled) {
+      ProfileScope streamScope(Profiler::Stream);
+      streamer.configure(*config);
+      streamer.send(result.crop.image);
+    }
+    if(isRecording) {
+      recordQueue.push(std::move(result.crop));
+    }
+  }
+
+  // Only signal once until the GUI thread has drained the queues again so a
+  // busy GUI thread doesn't pile up queued events
+  if(!notifyPending.exchange(true)) {
+    emit framesAvailable();
+  }
+}
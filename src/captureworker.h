@@ -0,0 +1,98 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            captureworker.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __CAPTUREWORKER_H__
+#define __CAPTUREWORKER_H__
+
+#include "framequeue.h"
+#include "captureconfig.h"
+#include "capturepipeline.h"
+#include "cursortracker.h"
+#include "ledstreamer.h"
+
+#include <QObject>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+
+#include <atomic>
+
+class CaptureWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  CaptureWorker(const CaptureConfigStore &configStore, const CursorTracker &cursorTracker);
+  ~CaptureWorker();
+  void setRecording(const bool &recording);
+  void setPreview(const bool &preview);
+  void acknowledgeFrames();
+  // Detects the pixel grid on the next grab and queues the result
+  void detectGrid();
+  // Time spent on motion estimation for the latest frame
+  qint64 motionEstimateNsecs() const;
+  // Ticks that were skipped because capture couldn't keep up, and recorded
+  // ticks whose look-ahead crop fell outside the region of interest
+  int skippedTicks() const;
+  void resetSkippedTicks();
+
+  // Written by the capture thread, drained by the GUI thread
+  FrameQueue<CapturedFrame> previewQueue{4};
+  FrameQueue<CapturedFrame> recordQueue{256};
+  FrameQueue<PixelGrid> gridQueue{4};
+
+public slots:
+  void start();
+  void stop();
+
+signals:
+  void framesAvailable();
+
+protected:
+  void timerEvent(QTimerEvent *event);
+
+private:
+  qint64 deadline(const quint64 &idx) const;
+  void scheduleTick();
+  const CaptureConfigStore &configStore;
+  const CursorTracker &cursorTracker;
+  int fps = 0;
+  // Tick n is due at epoch + n / fps seconds on the capture clock
+  qint64 epoch = 0;
+  quint64 deadlineIdx = 0;
+  std::atomic<int> skipped{0};
+  QBasicTimer grabTimer;
+  QElapsedTimer clock;
+  std::atomic<bool> recording{false};
+  std::atomic<bool> preview{true};
+  std::atomic<bool> notifyPending{false};
+  std::atomic<bool> gridRequested{false};
+  CapturePipeline pipeline;
+  LedStreamer streamer;
+  std::atomic<qint64> motionNsecs{0};
+
+};
+
+#endif // __CAPTUREWORKER_H__
@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            cursortracker.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "cursortracker.h"
+
+#include <QGuiApplication>
+#include <QCursor>
+#include <QScreen>
+#include <QTimerEvent>
+
+namespace
+{
+  // Samples further apart than this don't give a useful velocity, and the
+  // position is never extrapolated further ahead than this
+  const qint64 maxExtrapolationNsecs = 50000000;
+}
+
+CursorTracker::CursorTracker(const CaptureConfigStore &configStore, QObject *parent)
+  : QObject(parent), configStore(configStore)
+{
+  clock.start();
+  connect(qGuiApp, &QGuiApplication::screenAdded, this, &CursorTracker::updateScreens);
+  connect(qGuiApp, &QGuiApplication::screenRemoved, this, &CursorTracker::updateScreens);
+  connect(qGuiApp, &QGuiApplication::primaryScreenChanged, this, &CursorTracker::updateScreens);
+  updateScreens();
+  sample();
+}
+
+CursorTracker::~CursorTracker()
+{
+}
+
+QPoint CursorTracker::position() const
+{
+  QMutexLocker locker(&sampleMutex);
+  const Sample current = latest;
+  locker.unlock();
+  // A stalled GUI thread would otherwise leave the cursor frozen at the last
+  // sample until it catches up
+  const qint64 age = qBound(0LL, clock.nsecsElapsed() - current.nsecs, maxExtrapolationNsecs);
+  return current.pos + (current.velocity * (age / 1000000000.0)).toPoint();
+}
+
+ScreenInfo CursorTracker::screenAt(const QPoint &pos) const
+{
+  QMutexLocker locker(&screensMutex);
+  const std::shared_ptr<const QVector<ScreenInfo> > current = screens;
+  locker.unlock();
+  for(const auto &screen: *current) {
+    if(screen.geometry.contains(pos)) {
+      return screen;
+    }
+  }
+  return current->value(0);
+}
+
+void CursorTracker::timerEvent(QTimerEvent *event)
+{
+  if(event->timerId() == sampleTimer.timerId()) {
+    sample();
+  }
+}
+
+void CursorTracker::sample()
+{
+  const QPoint pos = QCursor::pos();
+  const qint64 now = clock.nsecsElapsed();
+  {
+    QMutexLocker locker(&sampleMutex);
+    const qint64 elapsed = now - latest.nsecs;
+    if(elapsed > 0 && elapsed <= maxExtrapolationNsecs) {
+      latest.velocity = QPointF(pos - latest.pos) * (1000000000.0 / elapsed);
+    } else {
+      latest.velocity = QPointF();
+    }
+    latest.pos = pos;
+    latest.nsecs = now;
+  }
+  // Follows changes of the capture rate. Sampling at twice the rate keeps
+  // the millisecond timer resolution from making a sample a whole tick old
+  if(configStore.current().fps != fps || !sampleTimer.isActive()) {
+    fps = configStore.current().fps;
+    sampleTimer.start(qMax(1, 500 / qMax(1, fps)), Qt::PreciseTimer, this);
+  }
+}
+
+void CursorTracker::updateScreens()
+{
+  std::shared_ptr<QVector<ScreenInfo> > updated = std::make_shared<QVector<ScreenInfo> >();
+  QScreen *primary = QGuiApplication::primaryScreen();
+  for(auto *screen: QGuiApplication::screens()) {
+    connect(screen, &QScreen::geometryChanged, this, &CursorTracker::updateScreens, Qt::UniqueConnection);
+    ScreenInfo info;
+    info.name = screen->name();
+    info.geometry = screen->geometry();
+    if(screen == primary) {
+      updated->prepend(info);
+    } else {
+      updated->append(info);
+    }
+  }
+  std::shared_ptr<const QVector<ScreenInfo> > previous(updated);
+  QMutexLocker locker(&screensMutex);
+  screens.swap(previous);
+}
@@ -0,0 +1,87 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            cursortracker.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __CURSORTRACKER_H__
+#define __CURSORTRACKER_H__
+
+#include "captureconfig.h"
+#include "capturesource.h"
+
+#include <QObject>
+#include <QPoint>
+#include <QPointF>
+#include <QVector>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <memory>
+
+// Samples the cursor position and the screen layout on the GUI thread, where
+// QCursor and QGuiApplication may be used. The cursor is sampled at twice the
+// capture rate, the screens whenever they change. Cursor samples are
+// timestamped, so the capture thread can extrapolate the position when the
+// GUI thread falls behind
+class CursorTracker : public QObject
+{
+  Q_OBJECT
+
+public:
+  CursorTracker(const CaptureConfigStore &configStore, QObject *parent = nullptr);
+  ~CursorTracker();
+  // These two may be called from any thread
+  QPoint position() const;
+  // The screen containing the point, otherwise the primary screen
+  ScreenInfo screenAt(const QPoint &pos) const;
+
+protected:
+  void timerEvent(QTimerEvent *event);
+
+private slots:
+  void updateScreens();
+
+private:
+  struct Sample
+  {
+    QPoint pos;
+    // Pixels per second
+    QPointF velocity;
+    qint64 nsecs = 0;
+  };
+  void sample();
+  const CaptureConfigStore &configStore;
+  int fps = 0;
+  QBasicTimer sampleTimer;
+  QElapsedTimer clock;
+  mutable QMutex sampleMutex;
+  Sample latest;
+  // The primary screen comes first
+  mutable QMutex screensMutex;
+  std::shared_ptr<const QVector<ScreenInfo> > screens;
+
+};
+
+#endif // __CURSORTRACKER_H__
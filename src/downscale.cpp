@@ -0,0 +1,253 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            downscale.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "downscale.h"
+
+#include <string.h>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DOWNSCALE_AVX2
+#endif
+
+namespace
+{
+  // Column sums of up to 32 rows of 8 bit channels, 32 * 255 fits in 16 bits
+  void sumRowsScalar(const uchar *src, const int &stride, const int &factor, quint16 *sums, const int &count)
+  {
+    memset(sums, 0, count * sizeof(quint16));
+    for(int row = 0; row < factor; ++row) {
+      const uchar *line = src + (row * stride);
+      for(int a = 0; a < count; ++a) {
+        sums[a] += line[a];
+      }
+    }
+  }
+
+#ifdef __SSE2__
+  void sumRowsSse2(const uchar *src, const int &stride, const int &factor, quint16 *sums, const int &count)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    int a = 0;
+    for(; a + 16 <= count; a += 16) {
+      __m128i low = zero;
+      __m128i high = zero;
+      for(int row = 0; row < factor; ++row) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)(src + (row * stride) + a));
+        low = _mm_add_epi16(low, _mm_unpacklo_epi8(bytes, zero));
+        high = _mm_add_epi16(high, _mm_unpackhi_epi8(bytes, zero));
+      }
+      _mm_storeu_si128((__m128i *)(sums + a), low);
+      _mm_storeu_si128((__m128i *)(sums + a + 8), high);
+    }
+    for(; a < count; ++a) {
+      quint16 sum = 0;
+      for(int row = 0; row < factor; ++row) {
+        sum += src[(row * stride) + a];
+      }
+      sums[a] = sum;
+    }
+  }
+#endif
+
+#ifdef DOWNSCALE_AVX2
+  __attribute__((target("avx2")))
+  void sumRowsAvx2(const uchar *src, const int &stride, const int &factor, quint16 *sums, const int &count)
+  {
+    int a = 0;
+    for(; a + 32 <= count; a += 32) {
+      __m256i low = _mm256_setzero_si256();
+      __m256i high = _mm256_setzero_si256();
+      for(int row = 0; row < factor; ++row) {
+        const uchar *line = src + (row * stride) + a;
+        // Widening whole 128 bit halves keeps the sums in pixel order
+        low = _mm256_add_epi16(low, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)line)));
+        high = _mm256_add_epi16(high, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(line + 16))));
+      }
+      _mm256_storeu_si256((__m256i *)(sums + a), low);
+      _mm256_storeu_si256((__m256i *)(sums + a + 16), high);
+    }
+    for(; a < count; ++a) {
+      quint16 sum = 0;
+      for(int row = 0; row < factor; ++row) {
+        sum += src[(row * stride) + a];
+      }
+      sums[a] = sum;
+    }
+  }
+#endif
+
+  // Divides by the block area with a multiply and shift. With
+  // multiplier = 2^32 / area + 1 the result is exact as long as
+  // sum * area < 2^32, which holds for sums up to 32 * 32 * 255
+  quint32 multiplierFor(const int &area)
+  {
+    return (quint32)((Q_UINT64_C(0x100000000) / area) + 1);
+  }
+
+  void reduceColumnsScalar(const quint16 *sums, quint32 *dst, const int &width, const int &factor)
+  {
+    const int area = factor * factor;
+    const quint64 multiplier = multiplierFor(area);
+    for(int x = 0; x < width; ++x) {
+      quint32 channels[4] = {(quint32)area / 2, (quint32)area / 2, (quint32)area / 2, (quint32)area / 2};
+      const quint16 *block = sums + (x * factor * 4);
+      for(int a = 0; a < factor * 4; a += 4) {
+        channels[0] += block[a];
+        channels[1] += block[a + 1];
+        channels[2] += block[a + 2];
+        channels[3] += block[a + 3];
+      }
+      quint32 pixel = 0;
+      for(int c = 0; c < 4; ++c) {
+        pixel |= (quint32)((channels[c] * multiplier) >> 32) << (c * 8);
+      }
+      dst[x] = pixel;
+    }
+  }
+
+#ifdef __SSE2__
+  void reduceColumnsSse2(const quint16 *sums, quint32 *dst, const int &width, const int &factor)
+  {
+    const int area = factor * factor;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(area / 2);
+    const __m128i multiplier = _mm_set1_epi32(multiplierFor(area));
+    const __m128i highMask = _mm_set_epi32(-1, 0, -1, 0);
+    for(int x = 0; x < width; ++x) {
+      __m128i channels = rounding;
+      const quint16 *block = sums + (x * factor * 4);
+      for(int a = 0; a < factor * 4; a += 4) {
+        channels = _mm_add_epi32(channels, _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(block + a)), zero));
+      }
+      // The high halves of the 64 bit products are the quotients
+      const __m128i even = _mm_srli_epi64(_mm_mul_epu32(channels, multiplier), 32);
+      const __m128i odd = _mm_and_si128(_mm_mul_epu32(_mm_srli_epi64(channels, 32), multiplier), highMask);
+      const __m128i quotients = _mm_or_si128(even, odd);
+      const __m128i words = _mm_packs_epi32(quotients, quotients);
+      dst[x] = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    }
+  }
+#endif
+
+  void boxRows(const uchar *src, const int &stride, quint32 *dst, const int &width, const int &factor,
+               quint16 *sums, const Downscale::InstructionSet &instructionSet)
+  {
+    const int count = width * factor * 4;
+    switch(instructionSet) {
+#ifdef DOWNSCALE_AVX2
+    case Downscale::Avx2:
+      sumRowsAvx2(src, stride, factor, sums, count);
+      reduceColumnsSse2(sums, dst, width, factor);
+      return;
+#endif
+#ifdef __SSE2__
+    case Downscale::Sse2:
+      sumRowsSse2(src, stride, factor, sums, count);
+      reduceColumnsSse2(sums, dst, width, factor);
+      return;
+#endif
+    default:
+      sumRowsScalar(src, stride, factor, sums, count);
+      reduceColumnsScalar(sums, dst, width, factor);
+    }
+  }
+
+  void nearestRow(const quint32 *src, quint32 *dst, const int &width, const int &factor)
+  {
+    // A strided gather, plain loads are as fast as SIMD gathers here
+    src += factor / 2;
+    for(int x = 0; x < width; ++x) {
+      dst[x] = src[x * factor];
+    }
+  }
+}
+
+Downscale::Mode Downscale::modeFromName(const QString &name)
+{
+  return name == "box"?Box:Nearest;
+}
+
+bool Downscale::isSupported(const InstructionSet &instructionSet)
+{
+  switch(instructionSet) {
+  case Auto:
+  case Scalar:
+    return true;
+  case Sse2:
+#ifdef __SSE2__
+    return true;
+#else
+    return false;
+#endif
+  case Avx2: {
+#ifdef DOWNSCALE_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+#else
+    return false;
+#endif
+  }
+  }
+  return false;
+}
+
+bool Downscale::scale(const QImage &source, QImage &destination, const int &factor, const Mode &mode,
+                      const InstructionSet &instructionSet)
+{
+  if(factor < 1 || factor > 32 ||
+     source.depth() != 32 || destination.depth() != 32 ||
+     destination.width() * factor > source.width() ||
+     destination.height() * factor > source.height() ||
+     !isSupported(instructionSet)) {
+    return false;
+  }
+  InstructionSet kernel = instructionSet;
+  if(kernel == Auto) {
+    kernel = isSupported(Avx2)?Avx2:(isSupported(Sse2)?Sse2:Scalar);
+  }
+  const int width = destination.width();
+  const int stride = source.bytesPerLine();
+  static thread_local std::vector<quint16> sums;
+  if(mode == Box && factor > 1 && (int)sums.size() < width * factor * 4) {
+    sums.resize(width * factor * 4);
+  }
+  for(int y = 0; y < destination.height(); ++y) {
+    quint32 *dst = (quint32 *)destination.scanLine(y);
+    if(factor == 1) {
+      memcpy(dst, source.constScanLine(y), width * 4);
+    } else if(mode == Box) {
+      boxRows(source.constScanLine(y * factor), stride, dst, width, factor, sums.data(), kernel);
+    } else {
+      nearestRow((const quint32 *)source.constScanLine((y * factor) + (factor / 2)), dst, width, factor);
+    }
+  }
+  return true;
+}
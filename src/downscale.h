@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            downscale.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __DOWNSCALE_H__
+#define __DOWNSCALE_H__
+
+#include <QImage>
+#include <QString>
+
+// Integer factor downscaling of 32 bit images. Output pixel (x, y) is computed
+// from the factor x factor block of source pixels starting at (x * factor,
+// y * factor), so a grab whose origin sits on the snap alignment grid maps
+// each screen pixel block to exactly one output pixel. Nearest takes the pixel
+// at the block center, box averages the whole block with rounding
+namespace Downscale
+{
+  enum Mode {
+    Nearest,
+    Box
+  };
+  enum InstructionSet {
+    Auto,
+    Scalar,
+    Sse2,
+    Avx2
+  };
+  Mode modeFromName(const QString &name);
+  bool isSupported(const InstructionSet &instructionSet);
+  // Factors 1 to 32. The destination is written in place and must be a 32 bit
+  // image no larger than the source divided by the factor
+  bool scale(const QImage &source, QImage &destination, const int &factor, const Mode &mode,
+             const InstructionSet &instructionSet = Auto);
+}
+
+#endif // __DOWNSCALE_H__
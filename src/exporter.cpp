@@ -0,0 +1,211 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            exporter.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "exporter.h"
+#include "profiler.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+Exporter::Exporter(QObject *parent)
+  : QObject(parent)
+{
+  connect(&watcher, &QFutureWatcher<void>::progressValueChanged, this, [this](int value) {
+    emit progress(value, jobs.count());
+  });
+  connect(&watcher, &QFutureWatcher<void>::finished, this, &Exporter::jobsFinished);
+}
+
+Exporter::~Exporter()
+{
+  watcher.cancel();
+  watcher.waitForFinished();
+  while(stagingInFlight > 0) {
+    QThread::msleep(1);
+  }
+}
+
+QString Exporter::frameFileName(const QString &frameName, const int &idx)
+{
+  return frameName + QString("%1").arg(idx, 6, 10, QChar('0')) + ".png";
+}
+
+QStringList Exporter::existingFrames(const QString &path, const QString &frameName)
+{
+  // A single directory scan filtered by the frame name pattern
+  return QDir(path).entryList({frameName + "*.png"}, QDir::Files);
+}
+
+QString Exporter::regionFileName(const QString &fileName, const QString &region)
+{
+  const QFileInfo info(fileName);
+  const QString baseName = info.completeBaseName() + "-" + region;
+  return info.dir().filePath(info.suffix().isEmpty()?baseName:baseName + "." + info.suffix());
+}
+
+void Exporter::setStagingPath(const QString &path)
+{
+  stagingPath = path;
+  if(!stagingPath.isEmpty()) {
+    QDir().mkpath(stagingPath);
+  }
+}
+
+void Exporter::stageFrame(const int &frame, const QImage &image)
+{
+  if(stagingPath.isEmpty()) {
+    return;
+  }
+  // Keep the amount of frames waiting for the encoder bounded. Frames that
+  // are skipped here are simply encoded when the actual export is started
+  if(stagingInFlight >= QThread::idealThreadCount() * 2) {
+    return;
+  }
+  stagingInFlight++;
+  const QString fileName = stagingPath + "/" + frameFileName("frame", frame);
+  QThreadPool::globalInstance()->start([this, frame, image, fileName]() {
+    if(image.save(fileName)) {
+      QMutexLocker locker(&stagedMutex);
+      staged.insert(frame);
+    }
+    stagingInFlight--;
+  });
+}
+
+void Exporter::clearStaging()
+{
+  while(stagingInFlight > 0) {
+    QThread::msleep(1);
+  }
+  QMutexLocker locker(&stagedMutex);
+  if(!stagingPath.isEmpty()) {
+    for(const auto &fileName: existingFrames(stagingPath, "frame")) {
+      QFile::remove(stagingPath + "/" + fileName);
+    }
+  }
+  staged.clear();
+}
+
+void Exporter::setPostProcess(const PostProcess &postProcess)
+{
+  this->postProcess = postProcess;
+}
+
+bool Exporter::start(const FrameStore &frames, const QVector<int> &holds, const QString &path, const QString &frameName)
+{
+  return start(QVector<ExportSet>({{&frames, holds, path}}), frameName);
+}
+
+bool Exporter::start(const QVector<ExportSet> &sets, const QString &frameName)
+{
+  if(isRunning()) {
+    return false;
+  }
+  jobs.clear();
+  for(int setIdx = 0; setIdx < sets.count(); ++setIdx) {
+    const ExportSet &set = sets.at(setIdx);
+    jobs.reserve(jobs.count() + set.frames->count());
+    int fileIdx = 0;
+    for(int idx = 0; idx < set.frames->count(); ++idx) {
+      QStringList fileNames;
+      for(int tick = 0; tick < set.holds.value(idx); ++tick) {
+        fileNames.append(set.path + "/" + frameFileName(frameName, fileIdx++));
+      }
+      if(!fileNames.isEmpty()) {
+        // Staged frames are looked up by index, -1 never matches
+        jobs.append({set.frames->frame(idx), setIdx == 0?idx:-1, fileNames});
+      }
+    }
+  }
+  written = 0;
+  emit progress(0, jobs.count());
+  watcher.setFuture(QtConcurrent::map(jobs, [this](ExportJob &job) {
+    encode(job);
+  }));
+  return true;
+}
+
+bool Exporter::isRunning() const
+{
+  return watcher.isRunning();
+}
+
+int Exporter::writtenFiles() const
+{
+  return written;
+}
+
+void Exporter::cancel()
+{
+  watcher.cancel();
+}
+
+void Exporter::encode(ExportJob &job)
+{
+  ProfileScope scope(Profiler::Encode);
+  // Frames that were already encoded while recording only need to be moved
+  // into place. Staged frames are uncorrected, so they can't be used along
+  // with post-processing
+  bool isStaged = false;
+  if(postProcess.isIdentity()) {
+    QMutexLocker locker(&stagedMutex);
+    isStaged = staged.remove(job.frame);
+  }
+  const QString &fileName = job.fileNames.first();
+  bool saved = isStaged &&
+    QFile::rename(stagingPath + "/" + frameFileName("frame", job.frame), fileName);
+  if(!saved) {
+    if(postProcess.isIdentity()) {
+      saved = job.image.save(fileName);
+    } else {
+      QImage corrected;
+      postProcess.apply(job.image, corrected);
+      saved = corrected.save(fileName);
+    }
+  }
+  if(!saved) {
+    return;
+  }
+  written++;
+  // Repeated ticks of a held frame are plain file copies, no re-encoding
+  for(int idx = 1; idx < job.fileNames.count(); ++idx) {
+    if(QFile::copy(fileName, job.fileNames.at(idx))) {
+      written++;
+    }
+  }
+}
+
+void Exporter::jobsFinished()
+{
+  const bool cancelled = watcher.isCanceled();
+  jobs.clear();
+  emit finished(cancelled);
+}
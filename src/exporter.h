@@ -0,0 +1,105 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            exporter.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __EXPORTER_H__
+#define __EXPORTER_H__
+
+#include "framestore.h"
+#include "postprocess.h"
+
+#include <QObject>
+#include <QImage>
+#include <QVector>
+#include <QSet>
+#include <QMutex>
+#include <QFutureWatcher>
+
+#include <atomic>
+
+struct ExportJob
+{
+  QImage image;
+  int frame = 0;
+  // A held frame is written once per tick it is held for
+  QStringList fileNames;
+};
+
+// Frames of one store written to one directory
+struct ExportSet
+{
+  const FrameStore *frames = nullptr;
+  QVector<int> holds;
+  QString path;
+};
+
+class Exporter : public QObject
+{
+  Q_OBJECT
+
+public:
+  Exporter(QObject *parent = nullptr);
+  ~Exporter();
+  static QString frameFileName(const QString &frameName, const int &idx);
+  static QStringList existingFrames(const QString &path, const QString &frameName);
+  // 'anim.rgla' becomes 'anim-<region>.rgla'
+  static QString regionFileName(const QString &fileName, const QString &region);
+  void setStagingPath(const QString &path);
+  void stageFrame(const int &frame, const QImage &image);
+  void clearStaging();
+  // Applied to every frame of the following exports
+  void setPostProcess(const PostProcess &postProcess);
+  // Each frame is written once per hold, frames with a hold of 0 are skipped
+  bool start(const FrameStore &frames, const QVector<int> &holds, const QString &path, const QString &frameName);
+  // Exports several stores as one job. Only the first set uses staged frames
+  bool start(const QVector<ExportSet> &sets, const QString &frameName);
+  bool isRunning() const;
+  // Files written by the latest export so far
+  int writtenFiles() const;
+
+public slots:
+  void cancel();
+
+signals:
+  void progress(int done, int total);
+  void finished(bool cancelled);
+
+private slots:
+  void jobsFinished();
+
+private:
+  void encode(ExportJob &job);
+  PostProcess postProcess;
+  QString stagingPath;
+  QSet<int> staged;
+  QMutex stagedMutex;
+  std::atomic<int> stagingInFlight{0};
+  std::atomic<int> written{0};
+  QVector<ExportJob> jobs;
+  QFutureWatcher<void> watcher;
+
+};
+
+#endif // __EXPORTER_H__
@@ -0,0 +1,365 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            framejournal.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "framejournal.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const char magic[4] = {'R', 'G', 'J', '1'};
+  const int version = 1;
+  const int headerSize = 32;
+  // Maps cover 64 MiB and start every 32 MiB, so any frame up to 32 MiB lies
+  // fully inside one of them
+  const qint64 windowStep = 32 * 1024 * 1024;
+  const qint64 windowSize = 2 * windowStep;
+  // Queued records are synced to disk at least this often
+  const int syncIntervalMs = 250;
+  const int syncBytes = 8 * 1024 * 1024;
+  // Queued bytes before appending waits for the writer. With a stalled disk
+  // the recording then backs up into the capture queue, where dropped
+  // frames are counted, instead of into memory
+  const qint64 maxPendingBytes = 64 * 1024 * 1024;
+}
+
+static_assert(sizeof(JournalRecord) == 32, "JournalRecord must be 32 bytes");
+
+FrameJournal::FrameJournal()
+{
+}
+
+FrameJournal::~FrameJournal()
+{
+  close();
+}
+
+quint32 FrameJournal::recordCheck(const JournalRecord &record)
+{
+  // FNV-1a over everything but the check itself
+  const uchar *bytes = (const uchar *)&record;
+  quint32 value = 2166136261u;
+  for(int idx = 0; idx < (int)offsetof(JournalRecord, check); ++idx) {
+    value = (value ^ bytes[idx]) * 16777619u;
+  }
+  return value;
+}
+
+bool FrameJournal::create(const QString &fileName, const int &pixelFormat, const QSize &frameSize, const int &frameBytes)
+{
+  this->fileName = fileName;
+  format = pixelFormat;
+  size = frameSize;
+  bytesPerFrame = frameBytes;
+  QDir().mkpath(QFileInfo(fileName).absolutePath());
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+  uchar header[headerSize] = {0};
+  memcpy(header, magic, 4);
+  qToLittleEndian<quint16>(version, header + 4);
+  qToLittleEndian<quint16>(headerSize, header + 6);
+  qToLittleEndian<quint16>(size.width(), header + 8);
+  qToLittleEndian<quint16>(size.height(), header + 10);
+  header[12] = format;
+  qToLittleEndian<quint32>(bytesPerFrame, header + 16);
+  qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 20);
+  if(file.write((const char *)header, headerSize) != headerSize) {
+    return false;
+  }
+  file.close();
+  return startWriter(headerSize);
+}
+
+bool FrameJournal::open(const QString &fileName)
+{
+  this->fileName = fileName;
+  readFile.setFileName(fileName);
+  if(!readFile.open(QIODevice::ReadOnly) || readFile.size() < headerSize) {
+    return false;
+  }
+  uchar header[headerSize];
+  if(readFile.read((char *)header, headerSize) != headerSize ||
+     memcmp(header, magic, 4) != 0 ||
+     qFromLittleEndian<quint16>(header + 4) != version) {
+    return false;
+  }
+  size = QSize(qFromLittleEndian<quint16>(header + 8), qFromLittleEndian<quint16>(header + 10));
+  format = header[12];
+  bytesPerFrame = qFromLittleEndian<quint32>(header + 16);
+  written = readFile.size();
+  allocated = readFile.size();
+  return bytesPerFrame > 0 && bytesPerFrame <= windowStep;
+}
+
+bool FrameJournal::replay(const std::function<bool(const JournalRecord &, const qint64 &)> &visitor)
+{
+  qint64 fileSize = written;
+  qint64 offset = headerSize;
+  while(offset + (qint64)sizeof(JournalRecord) <= fileSize) {
+    const uchar *header = data(offset, sizeof(JournalRecord));
+    if(header == nullptr) {
+      break;
+    }
+    JournalRecord record;
+    memcpy(&record, header, sizeof(JournalRecord));
+    if(record.type == 0 && record.check == 0) {
+      // The zeroed space reserved ahead of the records by a writer that
+      // never got to close the journal
+      fileSize = offset;
+      break;
+    }
+    if(record.check != recordCheck(record) ||
+       (record.type != JournalRecord::Frame && record.type != JournalRecord::Hold)) {
+      break;
+    }
+    const qint64 payloadOffset = offset + sizeof(JournalRecord);
+    const qint64 end = payloadOffset + (record.type == JournalRecord::Frame?bytesPerFrame:0);
+    if(end > fileSize || !visitor(record, payloadOffset)) {
+      break;
+    }
+    offset = end;
+  }
+  if(offset < fileSize) {
+    printf("Frame journal '%s' ends with %lld bytes of incomplete records, they are discarded\n",
+           qPrintable(fileName), fileSize - offset);
+  }
+  return startWriter(offset);
+}
+
+bool FrameJournal::startWriter(const qint64 &size)
+{
+  // Maps made while replaying may reach past the cut below. Nothing holds
+  // on to them after replay()
+  {
+    QMutexLocker locker(&mapMutex);
+    for(const auto &window: windows) {
+      readFile.unmap(window.first);
+    }
+    windows.clear();
+  }
+  writeFile.setFileName(fileName);
+  allocated = 0;
+  if(!writeFile.open(QIODevice::ReadWrite | QIODevice::Unbuffered) ||
+     !writeFile.resize(size) ||
+     !reserve(size) ||
+     !writeFile.seek(size)) {
+    return false;
+  }
+  if(!readFile.isOpen() && !readFile.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  appendOffset = size;
+  written = size;
+  maxPending = qMax(maxPendingBytes, 2 * ((qint64)sizeof(JournalRecord) + bytesPerFrame));
+  failed = false;
+  stopping = false;
+  start(QThread::LowPriority);
+  return true;
+}
+
+bool FrameJournal::reserve(const qint64 &end)
+{
+  // Enough for the full window of the last byte. The reserved space is
+  // sparse where the file system allows it
+  const qint64 needed = ((end / windowStep) + 2) * windowStep;
+  if(needed <= allocated) {
+    return true;
+  }
+  if(!writeFile.resize(needed)) {
+    return false;
+  }
+  allocated = needed;
+  return true;
+}
+
+int FrameJournal::pixelFormat() const
+{
+  return format;
+}
+
+QSize FrameJournal::frameSize() const
+{
+  return size;
+}
+
+int FrameJournal::frameBytes() const
+{
+  return bytesPerFrame;
+}
+
+qint64 FrameJournal::appendFrame(JournalRecord record, const uchar *data)
+{
+  record.type = JournalRecord::Frame;
+  record.check = recordCheck(record);
+  QMutexLocker locker(&mutex);
+  while(!failed && pending.size() >= maxPending) {
+    drained.wait(&mutex);
+  }
+  if(!failed) {
+    pending.append((const char *)&record, sizeof(JournalRecord));
+    pending.append((const char *)data, bytesPerFrame);
+  }
+  const qint64 offset = appendOffset + sizeof(JournalRecord);
+  appendOffset += sizeof(JournalRecord) + bytesPerFrame;
+  wake.wakeOne();
+  return offset;
+}
+
+void FrameJournal::appendHold(JournalRecord record)
+{
+  record.type = JournalRecord::Hold;
+  record.check = recordCheck(record);
+  QMutexLocker locker(&mutex);
+  while(!failed && pending.size() >= maxPending) {
+    drained.wait(&mutex);
+  }
+  if(!failed) {
+    pending.append((const char *)&record, sizeof(JournalRecord));
+  }
+  appendOffset += sizeof(JournalRecord);
+  wake.wakeOne();
+}
+
+qint64 FrameJournal::writtenBytes() const
+{
+  return written;
+}
+
+bool FrameJournal::hasFailed() const
+{
+  return failed;
+}
+
+const uchar *FrameJournal::data(const qint64 &offset, const int &bytes)
+{
+  if(offset < 0 || offset + bytes > written) {
+    return nullptr;
+  }
+  QMutexLocker locker(&mapMutex);
+  const qint64 windowIdx = offset / windowStep;
+  const qint64 windowStart = windowIdx * windowStep;
+  QPair<uchar *, qint64> &window = windows[windowIdx];
+  if(window.first == nullptr) {
+    // While writing, the file is kept a window ahead of the records, so each
+    // window is mapped once at its full size and never has to grow
+    const qint64 mapSize = qMin(windowSize, allocated - windowStart);
+    uchar *mapped = mapSize > 0?readFile.map(windowStart, mapSize):nullptr;
+    if(mapped == nullptr) {
+      windows.remove(windowIdx);
+      return nullptr;
+    }
+    window = qMakePair(mapped, mapSize);
+  }
+  if(offset + bytes > windowStart + window.second) {
+    return nullptr;
+  }
+  return window.first + (offset - windowStart);
+}
+
+void FrameJournal::close()
+{
+  if(isRunning()) {
+    {
+      QMutexLocker locker(&mutex);
+      stopping = true;
+      wake.wakeOne();
+    }
+    wait();
+    // Trims the reserved space again. Maps reaching past the end stay valid,
+    // only written records are read through them
+    if(writeFile.resize(written)) {
+      allocated = written.load();
+    }
+  }
+  writeFile.close();
+}
+
+void FrameJournal::run()
+{
+  QElapsedTimer sinceSync;
+  sinceSync.start();
+  qint64 unsynced = 0;
+  QByteArray batch;
+  QMutexLocker locker(&mutex);
+  while(true) {
+    if(pending.isEmpty() && !stopping) {
+      wake.wait(&mutex, syncIntervalMs);
+    }
+    batch.swap(pending);
+    drained.wakeAll();
+    const bool stop = stopping;
+    locker.unlock();
+
+    if(!batch.isEmpty() && !failed) {
+      // Only what actually reached the file counts as written, the store
+      // drops frames from memory based on it
+      const qint64 bytes = reserve(written + batch.size())?writeFile.write(batch):-1;
+      if(bytes > 0) {
+        written += bytes;
+        unsynced += bytes;
+      }
+      if(bytes != batch.size()) {
+        printf("Could not write to frame journal '%s', no longer journaling: %s\n",
+               qPrintable(fileName), qPrintable(writeFile.errorString()));
+        failed = true;
+        locker.relock();
+        pending.clear();
+        drained.wakeAll();
+        locker.unlock();
+      }
+    }
+    batch.clear();
+    // Syncing is what makes the journal survive a crash of the whole system,
+    // but it is slow, so it is done for many records at once
+    if(unsynced > 0 && (stop || unsynced >= syncBytes || sinceSync.elapsed() >= syncIntervalMs)) {
+#if defined(Q_OS_LINUX)
+      fdatasync(writeFile.handle());
+#elif defined(Q_OS_UNIX)
+      fsync(writeFile.handle());
+#endif
+      unsynced = 0;
+      sinceSync.restart();
+    }
+
+    locker.relock();
+    if(stop && pending.isEmpty()) {
+      break;
+    }
+  }
+}
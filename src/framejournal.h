@@ -0,0 +1,139 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            framejournal.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __FRAMEJOURNAL_H__
+#define __FRAMEJOURNAL_H__
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QSize>
+
+#include <atomic>
+#include <functional>
+
+// Every record starts with this header, in host byte order
+struct JournalRecord
+{
+  enum Type : quint32 {
+    Frame = 0x464a4752, // "RGJF", followed by the packed frame
+    Hold = 0x484a4752   // "RGJH", the frame was held for more ticks
+  };
+  quint32 type = Frame;
+  quint32 frame = 0;
+  qint64 timestamp = -1;
+  // Hash of the frame data for frame records
+  quint64 hash = 0;
+  quint32 hold = 1;
+  // Covers the fields above, so torn writes are detected on replay
+  quint32 check = 0;
+};
+
+// Append-only file of recorded frames:
+//
+//   0  char[4]  magic "RGJ1"
+//   4  uint16   version
+//   6  uint16   header size in bytes
+//   8  uint16   frame width
+//  10  uint16   frame height
+//  12  uint8    pixel format, as in FrameStore
+//  13  uint8    reserved
+//  14  uint16   reserved
+//  16  uint32   bytes per frame
+//  20  int64    creation time in milliseconds since the epoch
+//  28  uint32   reserved
+//
+// followed by JournalRecords. Records are queued by the caller and written by
+// a background thread, which syncs them to disk in batches. The queue is
+// bounded, appending blocks while the writer is that far behind. Written
+// records can be read back through memory maps, which stay valid until the
+// journal is destroyed. While writing, the file is grown ahead of the records
+// so every map is made once at its full size, closing trims it again
+class FrameJournal : public QThread
+{
+public:
+  FrameJournal();
+  ~FrameJournal();
+  // Starts a new journal, replacing any file of the same name
+  bool create(const QString &fileName, const int &pixelFormat, const QSize &frameSize, const int &frameBytes);
+  // Reads the header of an existing journal. Follow with replay()
+  bool open(const QString &fileName);
+  // Calls the visitor for every record in order with the offset of its
+  // payload. Stops at the first record that is incomplete or that the visitor
+  // rejects, cuts the file there and continues appending after it
+  bool replay(const std::function<bool(const JournalRecord &, const qint64 &)> &visitor);
+  int pixelFormat() const;
+  QSize frameSize() const;
+  int frameBytes() const;
+  // Returns the offset of the frame data in the file
+  qint64 appendFrame(JournalRecord record, const uchar *data);
+  void appendHold(JournalRecord record);
+  // Bytes handed to the operating system so far, readable through data()
+  qint64 writtenBytes() const;
+  // A write failed. Nothing is written after that, so writtenBytes() stays
+  // at the end of the last complete write
+  bool hasFailed() const;
+  const uchar *data(const qint64 &offset, const int &bytes);
+  // Writes and syncs everything queued and stops the writer
+  void close();
+
+protected:
+  void run() override;
+
+private:
+  static quint32 recordCheck(const JournalRecord &record);
+  bool startWriter(const qint64 &size);
+  // Grows the file so the window holding the given end can be mapped whole.
+  // Only called by the writer
+  bool reserve(const qint64 &end);
+  QString fileName;
+  QFile writeFile;
+  QFile readFile;
+  int format = 0;
+  QSize size;
+  int bytesPerFrame = 0;
+  qint64 appendOffset = 0;
+  std::atomic<qint64> written{0};
+  // File size including the space reserved ahead of the records
+  std::atomic<qint64> allocated{0};
+  QMutex mutex;
+  QWaitCondition wake;
+  QWaitCondition drained;
+  QByteArray pending;
+  qint64 maxPending = 0;
+  std::atomic<bool> failed{false};
+  bool stopping = false;
+  QMutex mapMutex;
+  // Window index, mapped address and mapped size
+  QHash<qint64, QPair<uchar *, qint64> > windows;
+
+};
+
+#endif // __FRAMEJOURNAL_H__
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            framequeue.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __FRAMEQUEUE_H__
+#define __FRAMEQUEUE_H__
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue. push() is only ever called
+// from the capture thread and pop() only from the consumer thread, so the two
+// indices can be published with plain acquire / release ordering.
+template <typename T>
+class FrameQueue
+{
+public:
+  explicit FrameQueue(const int &capacity)
+    : items(capacity + 1)
+  {
+  }
+  FrameQueue(const FrameQueue &) = delete;
+  FrameQueue &operator=(const FrameQueue &) = delete;
+
+  // Returns false and counts the item as dropped if the consumer is lagging
+  bool push(T &&item)
+  {
+    const int currentTail = tail.load(std::memory_order_relaxed);
+    const int nextTail = increment(currentTail);
+    if(nextTail == head.load(std::memory_order_acquire)) {
+      droppedFrames.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items[currentTail] = std::move(item);
+    tail.store(nextTail, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &item)
+  {
+    const int currentHead = head.load(std::memory_order_relaxed);
+    if(currentHead == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(items[currentHead]);
+    items[currentHead] = T();
+    head.store(increment(currentHead), std::memory_order_release);
+    return true;
+  }
+
+  int capacity() const
+  {
+    return (int)items.size() - 1;
+  }
+
+  int dropped() const
+  {
+    return droppedFrames.load(std::memory_order_relaxed);
+  }
+
+  void resetDropped()
+  {
+    droppedFrames.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  int increment(const int &idx) const
+  {
+    return (idx + 1) % (int)items.size();
+  }
+
+  std::vector<T> items;
+  alignas(64) std::atomic<int> head{0};
+  alignas(64) std::atomic<int> tail{0};
+  std::atomic<int> droppedFrames{0};
+
+};
+
+#endif // __FRAMEQUEUE_H__
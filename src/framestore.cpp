@@ -0,0 +1,479 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            framestore.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "framestore.h"
+#include "pixelconvert.h"
+
+#include <QFile>
+
+#include <stdio.h>
+#include <string.h>
+
+constexpr int blockBytes = 4 * 1024 * 1024;
+
+FrameStore::FrameStore(const PixelFormat &pixelFormat)
+  : format(pixelFormat)
+{
+}
+
+FrameStore::~FrameStore()
+{
+}
+
+FrameStore::PixelFormat FrameStore::pixelFormatFromName(const QString &name)
+{
+  if(name == "rgb32") {
+    return Rgb32;
+  } else if(name == "rgb565") {
+    return Rgb565;
+  } else if(name == "rgb332") {
+    return Rgb332;
+  }
+  return Rgb888;
+}
+
+QString FrameStore::pixelFormatName(const PixelFormat &pixelFormat)
+{
+  switch(pixelFormat) {
+  case Rgb32:
+    return "rgb32";
+  case Rgb565:
+    return "rgb565";
+  case Rgb332:
+    return "rgb332";
+  default:
+    return "rgb888";
+  }
+}
+
+int FrameStore::bytesPerPixel(const PixelFormat &pixelFormat)
+{
+  switch(pixelFormat) {
+  case Rgb32:
+    return 4;
+  case Rgb565:
+    return 2;
+  case Rgb332:
+    return 1;
+  default:
+    return 3;
+  }
+}
+
+quint64 FrameStore::hash(const uchar *data, const int &bytes)
+{
+  // Multiply / rotate hash over 64 bit words. Not cryptographic, but fast and
+  // well mixed enough that equal hashes almost always mean equal frames
+  const quint64 k1 = 0x9e3779b185ebca87ULL;
+  const quint64 k2 = 0xc2b2ae3d27d4eb4fULL;
+  quint64 value = k2 ^ ((quint64)bytes * k1);
+  int offset = 0;
+  for(; offset + 8 <= bytes; offset += 8) {
+    quint64 word;
+    memcpy(&word, data + offset, 8);
+    value ^= word * k1;
+    value = ((value << 31) | (value >> 33)) * k2;
+  }
+  for(; offset < bytes; ++offset) {
+    value ^= data[offset] * k1;
+    value = ((value << 31) | (value >> 33)) * k2;
+  }
+  value ^= value >> 33;
+  value *= k1;
+  value ^= value >> 29;
+  return value;
+}
+
+void FrameStore::pack(const QImage &image, const PixelFormat &pixelFormat, uchar *destination)
+{
+  const int width = image.width();
+  const int lineBytes = width * bytesPerPixel(pixelFormat);
+  uchar *dst = destination;
+  for(int y = 0; y < image.height(); ++y) {
+    const quint32 *src = (const quint32 *)image.constScanLine(y);
+    switch(pixelFormat) {
+    case Rgb32:
+      memcpy(dst, src, lineBytes);
+      break;
+    case Rgb888:
+      PixelConvert::toRgb888(src, dst, width);
+      break;
+    case Rgb565:
+      PixelConvert::toRgb565(src, (quint16 *)dst, width);
+      break;
+    case Rgb332:
+      PixelConvert::toRgb332(src, dst, width);
+      break;
+    }
+    dst += lineBytes;
+  }
+}
+
+void FrameStore::setPixelFormat(const PixelFormat &pixelFormat)
+{
+  clear();
+  format = pixelFormat;
+}
+
+FrameStore::PixelFormat FrameStore::pixelFormat() const
+{
+  return format;
+}
+
+void FrameStore::setDeduplicate(const bool &deduplicate)
+{
+  this->deduplicate = deduplicate;
+}
+
+void FrameStore::setJournal(const QString &fileName, const qint64 &memoryBudget)
+{
+  clear();
+  journalFileName = fileName;
+  this->memoryBudget = memoryBudget;
+  // The journal itself is created along with the first frame
+  rotateJournal();
+}
+
+bool FrameStore::reopenJournal(const QString &fileName, const qint64 &memoryBudget)
+{
+  clear();
+  journalFileName = fileName;
+  this->memoryBudget = memoryBudget;
+  QSharedPointer<FrameJournal> reopened(new FrameJournal());
+  if(!reopened->open(fileName) ||
+     reopened->pixelFormat() > Rgb332 ||
+     reopened->frameSize().isEmpty() ||
+     reopened->frameBytes() != reopened->frameSize().width() * reopened->frameSize().height() *
+                               bytesPerPixel((PixelFormat)reopened->pixelFormat())) {
+    return false;
+  }
+  format = (PixelFormat)reopened->pixelFormat();
+  size = reopened->frameSize();
+  lineBytes = size.width() * bytesPerPixel(format);
+  framesPerBlock = qMax(1, blockBytes / frameBytes());
+  const bool replayed = reopened->replay([this, &reopened](const JournalRecord &record, const qint64 &offset) {
+    if(record.type == JournalRecord::Hold) {
+      if(frames == 0 || record.frame != (quint32)frames - 1) {
+        return false;
+      }
+      holds.last() += record.hold;
+      ticks += record.hold;
+      return true;
+    }
+    const uchar *data = reopened->data(offset, frameBytes());
+    if(record.frame != (quint32)frames || data == nullptr || hash(data, frameBytes()) != record.hash) {
+      return false;
+    }
+    hashes.append(record.hash);
+    holds.append(record.hold);
+    timestamps.append(record.timestamp);
+    journalOffsets.append(offset);
+    frames++;
+    ticks += record.hold;
+    return true;
+  });
+  if(!replayed || frames == 0) {
+    clear();
+    return false;
+  }
+  journal = reopened;
+  // All frames are in the journal. Only the last, partially filled block is
+  // read back into memory so new frames can be appended after it
+  blocks.resize((frames + framesPerBlock - 1) / framesPerBlock);
+  firstResidentBlock = frames / framesPerBlock;
+  if(frames % framesPerBlock != 0) {
+    blocks.last() = QSharedPointer<QByteArray>::create(framesPerBlock * frameBytes(), Qt::Uninitialized);
+    for(int idx = firstResidentBlock * framesPerBlock; idx < frames; ++idx) {
+      memcpy(blocks.last()->data() + ((idx % framesPerBlock) * frameBytes()),
+             journal->data(journalOffsets.at(idx), frameBytes()), frameBytes());
+    }
+  }
+  return true;
+}
+
+void FrameStore::rotateJournal()
+{
+  if(!journal.isNull()) {
+    journal->close();
+    journal.reset();
+  }
+  if(!journalFileName.isEmpty() && QFile::exists(journalFileName)) {
+    QFile::remove(journalFileName + ".bak");
+    QFile::rename(journalFileName, journalFileName + ".bak");
+  }
+}
+
+void FrameStore::evictBlocks()
+{
+  // Once the journal failed, frames after its last complete write are only in
+  // memory, so the remaining blocks stay resident
+  if(journal.isNull() || memoryBudget <= 0 || journal->hasFailed()) {
+    return;
+  }
+  // Only completely filled blocks whose frames have all been written to the
+  // journal file can be dropped. While the writer is behind the others wait
+  const int fullBlocks = frames / framesPerBlock;
+  while(firstResidentBlock < fullBlocks && memoryUsage() > memoryBudget) {
+    const int lastFrame = ((firstResidentBlock + 1) * framesPerBlock) - 1;
+    if(journalOffsets.at(lastFrame) + frameBytes() > journal->writtenBytes()) {
+      break;
+    }
+    blocks[firstResidentBlock].reset();
+    firstResidentBlock++;
+  }
+}
+
+FrameStore::AppendResult FrameStore::append(const QImage &image, const qint64 &timestamp, const int &hold)
+{
+  if(!prepareFrame(image.size())) {
+    return Rejected;
+  }
+  QImage source = image;
+  if(source.format() != QImage::Format_RGB32 &&
+     source.format() != QImage::Format_ARGB32 &&
+     source.format() != QImage::Format_ARGB32_Premultiplied) {
+    source = source.convertToFormat(QImage::Format_RGB32);
+  }
+
+  uchar *frame = allocateFrame();
+  pack(source, format, frame);
+  return commitFrame(frame, hold, timestamp);
+}
+
+FrameStore::AppendResult FrameStore::appendPacked(const QSize &frameSize, const uchar *data, const int &hold,
+                                                  const qint64 &timestamp)
+{
+  if(!prepareFrame(frameSize)) {
+    return Rejected;
+  }
+  uchar *frame = allocateFrame();
+  memcpy(frame, data, frameBytes());
+  return commitFrame(frame, hold, timestamp);
+}
+
+FrameStore::AppendResult FrameStore::commitFrame(const uchar *frame, const int &hold, const qint64 &timestamp)
+{
+  // The frame has been packed into the slot following the last frame. If it
+  // turns out to be a duplicate the slot is simply reused by the next frame
+  const quint64 frameHash = hash(frame, frameBytes());
+  JournalRecord record;
+  record.timestamp = timestamp;
+  record.hash = frameHash;
+  record.hold = hold;
+  ticks += hold;
+  if(deduplicate &&
+     frames > 0 &&
+     hashes.last() == frameHash &&
+     memcmp(frameData(frames - 1), frame, frameBytes()) == 0) {
+    holds.last() += hold;
+    if(!journal.isNull()) {
+      record.frame = frames - 1;
+      journal->appendHold(record);
+    }
+    return Held;
+  }
+  hashes.append(frameHash);
+  holds.append(hold);
+  timestamps.append(timestamp);
+  if(!journal.isNull()) {
+    record.frame = frames;
+    journalOffsets.append(journal->appendFrame(record, frame));
+  }
+  frames++;
+  evictBlocks();
+  return Appended;
+}
+
+bool FrameStore::prepareFrame(const QSize &frameSize)
+{
+  if(frameSize.isEmpty()) {
+    return false;
+  }
+  if(frames == 0) {
+    size = frameSize;
+    lineBytes = size.width() * bytesPerPixel(format);
+    framesPerBlock = qMax(1, blockBytes / frameBytes());
+    if(!journalFileName.isEmpty() && journal.isNull()) {
+      journal.reset(new FrameJournal());
+      if(!journal->create(journalFileName, format, size, frameBytes())) {
+        printf("Could not create frame journal '%s', recording to memory only\n", qPrintable(journalFileName));
+        journal.reset();
+        journalFileName.clear();
+      }
+    }
+  } else if(frameSize != size) {
+    return false;
+  }
+  return true;
+}
+
+uchar *FrameStore::allocateFrame()
+{
+  const int blockIdx = frames / framesPerBlock;
+  if(blockIdx >= blocks.count()) {
+    blocks.append(QSharedPointer<QByteArray>::create(framesPerBlock * frameBytes(), Qt::Uninitialized));
+  }
+  return (uchar *)blocks.at(blockIdx)->data() + ((frames % framesPerBlock) * frameBytes());
+}
+
+void FrameStore::clear()
+{
+  if(!journal.isNull()) {
+    rotateJournal();
+  }
+  journalOffsets.clear();
+  firstResidentBlock = 0;
+  blocks.clear();
+  hashes.clear();
+  holds.clear();
+  timestamps.clear();
+  frames = 0;
+  ticks = 0;
+  size = QSize();
+  lineBytes = 0;
+}
+
+int FrameStore::count() const
+{
+  return frames;
+}
+
+int FrameStore::hold(const int &idx) const
+{
+  return holds.value(idx, 1);
+}
+
+qint64 FrameStore::timestamp(const int &idx) const
+{
+  return timestamps.value(idx, -1);
+}
+
+QVector<int> FrameStore::holdsAt(const int &fps, const int &captureFps) const
+{
+  if(fps <= 0 || captureFps <= 0) {
+    return holds;
+  }
+  // Each frame spans until the next one was captured. A frame followed by a
+  // pause in recording only keeps one extra tick, so stopping and restarting
+  // a take doesn't turn into a long still. Output tick k lies at
+  // k * 10^9 / fps on the resulting timeline and shows the frame spanning it
+  const qint64 tickNsecs = 1000000000LL / captureFps;
+  QVector<int> resampled(frames, 0);
+  qint64 position = 0;
+  qint64 outputTicks = 0;
+  for(int idx = 0; idx < frames; ++idx) {
+    qint64 span = holds.at(idx) * tickNsecs;
+    if(idx + 1 < frames && timestamps.at(idx) >= 0 && timestamps.at(idx + 1) >= 0) {
+      span = qMin(timestamps.at(idx + 1) - timestamps.at(idx), (holds.at(idx) + 1) * tickNsecs);
+    }
+    position += qMax(0LL, span);
+    const qint64 end = ((position * fps) + 999999999LL) / 1000000000LL;
+    resampled[idx] = end - outputTicks;
+    outputTicks = end;
+  }
+  return resampled;
+}
+
+int FrameStore::totalTicks() const
+{
+  return ticks;
+}
+
+bool FrameStore::journalFailed() const
+{
+  return !journal.isNull() && journal->hasFailed();
+}
+
+bool FrameStore::isEmpty() const
+{
+  return frames == 0;
+}
+
+QSize FrameStore::frameSize() const
+{
+  return size;
+}
+
+int FrameStore::frameBytes() const
+{
+  return lineBytes * size.height();
+}
+
+qint64 FrameStore::memoryUsage() const
+{
+  // Only blocks still held in memory count
+  return (qint64)(blocks.count() - firstResidentBlock) * framesPerBlock * frameBytes();
+}
+
+const uchar *FrameStore::frameData(const int &idx) const
+{
+  const QSharedPointer<QByteArray> &block = blocks.at(idx / framesPerBlock);
+  if(block.isNull()) {
+    return journal->data(journalOffsets.at(idx), frameBytes());
+  }
+  return (const uchar *)block->constData() + ((idx % framesPerBlock) * frameBytes());
+}
+
+QImage FrameStore::frame(const int &idx) const
+{
+  if(idx < 0 || idx >= frames) {
+    return QImage();
+  }
+  QImage::Format imageFormat = QImage::Format_RGB888;
+  switch(format) {
+  case Rgb32:
+    imageFormat = QImage::Format_RGB32;
+    break;
+  case Rgb565:
+    imageFormat = QImage::Format_RGB16;
+    break;
+  case Rgb332:
+    imageFormat = QImage::Format_Indexed8;
+    break;
+  default:
+    break;
+  }
+  // Wraps the packed frame without copying. The image is read-only, so
+  // anything writing to its pixels detaches into a copy of its own first,
+  // and the shared block stays untouched. The image keeps its block, or for
+  // dropped blocks the journal and its memory maps, alive
+  const QSharedPointer<QByteArray> &block = blocks.at(idx / framesPerBlock);
+  QImage image = block.isNull()?
+    QImage(frameData(idx), size.width(), size.height(), lineBytes, imageFormat,
+           [](void *info) {
+             delete static_cast<QSharedPointer<FrameJournal> *>(info);
+           },
+           new QSharedPointer<FrameJournal>(journal)):
+    QImage(frameData(idx), size.width(), size.height(), lineBytes, imageFormat,
+           [](void *info) {
+             delete static_cast<QSharedPointer<QByteArray> *>(info);
+           },
+           new QSharedPointer<QByteArray>(block));
+  if(format == Rgb332) {
+    image.setColorTable(PixelConvert::rgb332Palette());
+  }
+  return image;
+}
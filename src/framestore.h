@@ -0,0 +1,129 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            framestore.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __FRAMESTORE_H__
+#define __FRAMESTORE_H__
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <QSharedPointer>
+
+#include "framejournal.h"
+
+// Recorded frames packed back to back in the panel's pixel format. Frames are
+// laid out contiguously in large blocks, so appending never moves frames that
+// have already been stored. With deduplication enabled a frame identical to
+// the previous one only increases the hold count of that frame.
+//
+// With a journal every frame is also written to an append-only file. Once
+// the frames held in memory exceed the memory budget, the oldest blocks are
+// dropped from memory and read back from the journal instead.
+//
+// A copy shares the blocks and the journal of the store, so it is a cheap
+// read-only snapshot that frames appended to or cleared from the original
+// later don't affect
+class FrameStore
+{
+public:
+  enum PixelFormat {
+    Rgb32,
+    Rgb888,
+    Rgb565,
+    Rgb332
+  };
+  enum AppendResult {
+    Rejected,
+    Appended,
+    Held
+  };
+  FrameStore(const PixelFormat &pixelFormat = Rgb888);
+  ~FrameStore();
+  static PixelFormat pixelFormatFromName(const QString &name);
+  static QString pixelFormatName(const PixelFormat &pixelFormat);
+  static int bytesPerPixel(const PixelFormat &pixelFormat);
+  static quint64 hash(const uchar *data, const int &bytes);
+  // Packs a 32 bit image into the pixel format, rows back to back
+  static void pack(const QImage &image, const PixelFormat &pixelFormat, uchar *destination);
+  void setPixelFormat(const PixelFormat &pixelFormat);
+  PixelFormat pixelFormat() const;
+  void setDeduplicate(const bool &deduplicate);
+  // Starts journaling to a new file. An existing journal of that name, and
+  // the current one whenever the store is cleared, is kept as '.bak'
+  void setJournal(const QString &fileName, const qint64 &memoryBudget);
+  // Continues the session recorded in an existing journal
+  bool reopenJournal(const QString &fileName, const qint64 &memoryBudget);
+  // Writing the journal failed, new frames are kept in memory only
+  bool journalFailed() const;
+  // Timestamps are monotonic nanoseconds of the first tick of a frame, -1 if
+  // unknown
+  AppendResult append(const QImage &image, const qint64 &timestamp = -1, const int &hold = 1);
+  AppendResult appendPacked(const QSize &frameSize, const uchar *data, const int &hold = 1,
+                            const qint64 &timestamp = -1);
+  void clear();
+  int count() const;
+  int hold(const int &idx) const;
+  qint64 timestamp(const int &idx) const;
+  // Hold counts for playing the frames back at exactly fps. Without a target
+  // rate these are the recorded holds, otherwise the recorded timestamps are
+  // resampled, which duplicates or drops frames (hold 0) as needed
+  QVector<int> holdsAt(const int &fps, const int &captureFps) const;
+  int totalTicks() const;
+  bool isEmpty() const;
+  QSize frameSize() const;
+  int frameBytes() const;
+  qint64 memoryUsage() const;
+  const uchar *frameData(const int &idx) const;
+  // Wraps the packed frame without copying. The image keeps its block alive
+  QImage frame(const int &idx) const;
+
+private:
+  bool prepareFrame(const QSize &frameSize);
+  uchar *allocateFrame();
+  AppendResult commitFrame(const uchar *frame, const int &hold, const qint64 &timestamp);
+  void rotateJournal();
+  void evictBlocks();
+  PixelFormat format = Rgb888;
+  bool deduplicate = false;
+  QSize size;
+  int lineBytes = 0;
+  int framesPerBlock = 1;
+  int frames = 0;
+  int ticks = 0;
+  QVector<QSharedPointer<QByteArray> > blocks;
+  QVector<quint64> hashes;
+  QVector<int> holds;
+  QVector<qint64> timestamps;
+  QString journalFileName;
+  qint64 memoryBudget = 0;
+  QSharedPointer<FrameJournal> journal;
+  QVector<qint64> journalOffsets;
+  // Blocks before this one have been dropped from memory
+  int firstResidentBlock = 0;
+
+};
+
+#endif // __FRAMESTORE_H__
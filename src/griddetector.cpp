@@ -0,0 +1,184 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            griddetector.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "griddetector.h"
+
+#include <QElapsedTimer>
+
+namespace
+{
+  // Transitions off the phase are tolerated up to this share, for dithered
+  // or slightly filtered scaling and the occasional overlay
+  const double minimumShare = 0.9;
+  // An axis needs transitions in this many places before it counts at all
+  const int minimumPlaces = 4;
+  const int maximumScale = 32;
+
+  int places(const QVector<int> &transitions)
+  {
+    int count = 0;
+    for(const auto &transition: transitions) {
+      count += transition > 0;
+    }
+    return count;
+  }
+
+  // Sums the transitions off the grid of the given scale and phase, split
+  // into those that still lie on the finer grid of the divisor and the rest.
+  // Places counts the positions of the former
+  void offGrid(const QVector<int> &transitions, const int &scale, const int &phase, const int &divisor,
+               qint64 &onDivisor, qint64 &offDivisor, int &places)
+  {
+    for(int idx = 0; idx < transitions.count(); ++idx) {
+      if(transitions.at(idx) == 0 || idx % scale == phase) {
+        continue;
+      }
+      if(idx % divisor == phase % divisor) {
+        onDivisor += transitions.at(idx);
+        places++;
+      } else {
+        offDivisor += transitions.at(idx);
+      }
+    }
+  }
+}
+
+GridDetector::GridDetector()
+{
+}
+
+GridDetector::~GridDetector()
+{
+}
+
+qint64 GridDetector::lastNsecs() const
+{
+  return nsecs;
+}
+
+double GridDetector::score(const QVector<int> &transitions, const int &scale, int &phase) const
+{
+  int phases[maximumScale] = {};
+  qint64 total = 0;
+  for(int idx = 0; idx < transitions.count(); ++idx) {
+    phases[idx % scale] += transitions.at(idx);
+    total += transitions.at(idx);
+  }
+  phase = 0;
+  for(int candidate = 1; candidate < scale; ++candidate) {
+    if(phases[candidate] > phases[phase]) {
+      phase = candidate;
+    }
+  }
+  return total > 0?phases[phase] / (double)total:0.0;
+}
+
+bool GridDetector::detect(const QImage &image, PixelGrid &grid)
+{
+  QElapsedTimer timer;
+  timer.start();
+  grid = PixelGrid();
+  const QImage input = image.depth() == 32?image:image.convertToFormat(QImage::Format_RGB32);
+  const int width = input.width();
+  const int height = input.height();
+  if(width < 2 || height < 2) {
+    return false;
+  }
+  // Entry n counts the screen pixels that differ from the one before them,
+  // so it is high where a source pixel starts. Plain loops without branches
+  // so the compiler vectorizes them
+  columns.fill(0, width);
+  rows.fill(0, height);
+  const QRgb *previous = nullptr;
+  for(int y = 0; y < height; ++y) {
+    const QRgb *line = (const QRgb *)input.constScanLine(y);
+    int *column = columns.data();
+    for(int x = 1; x < width; ++x) {
+      column[x] += ((line[x] ^ line[x - 1]) & 0x00ffffff) != 0;
+    }
+    if(previous != nullptr) {
+      int changed = 0;
+      for(int x = 0; x < width; ++x) {
+        changed += ((line[x] ^ previous[x]) & 0x00ffffff) != 0;
+      }
+      rows[y] = changed;
+    }
+    previous = line;
+  }
+
+  const bool useColumns = places(columns) >= minimumPlaces;
+  const bool useRows = places(rows) >= minimumPlaces;
+  if(useColumns || useRows) {
+    // At least four source pixels across the axes that are used
+    const int largest = qMin(maximumScale, qMin(useColumns?width / minimumPlaces:maximumScale,
+                                                useRows?height / minimumPlaces:maximumScale));
+    for(int scale = largest; scale >= 2; --scale) {
+      int phaseX = 0;
+      int phaseY = 0;
+      if((!useColumns || score(columns, scale, phaseX) >= minimumShare) &&
+         (!useRows || score(rows, scale, phaseY) >= minimumShare)) {
+        grid.found = true;
+        grid.scale = scale;
+        grid.hasPhaseX = useColumns;
+        grid.hasPhaseY = useRows;
+        grid.phaseX = phaseX;
+        grid.phaseY = phaseY;
+        break;
+      }
+    }
+    // On sparse content, like a few sprites on a plain background, nearly
+    // all edges may fall on a multiple of the real scale, which then only
+    // shows in a few details. While the edges off the grid line up with
+    // the grid of a divisor, that divisor is taken instead
+    bool refined = grid.found;
+    while(refined) {
+      refined = false;
+      for(int divisor = grid.scale / 2; divisor >= 2; --divisor) {
+        if(grid.scale % divisor != 0) {
+          continue;
+        }
+        qint64 onDivisor = 0;
+        qint64 offDivisor = 0;
+        int evidence = 0;
+        if(useColumns) {
+          offGrid(columns, grid.scale, grid.phaseX, divisor, onDivisor, offDivisor, evidence);
+        }
+        if(useRows) {
+          offGrid(rows, grid.scale, grid.phaseY, divisor, onDivisor, offDivisor, evidence);
+        }
+        if(evidence >= minimumPlaces && onDivisor >= minimumShare * (onDivisor + offDivisor)) {
+          grid.scale = divisor;
+          grid.phaseX %= divisor;
+          grid.phaseY %= divisor;
+          refined = true;
+          break;
+        }
+      }
+    }
+  }
+  nsecs = timer.nsecsElapsed();
+  return grid.found;
+}
@@ -0,0 +1,70 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            griddetector.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __GRIDDETECTOR_H__
+#define __GRIDDETECTOR_H__
+
+#include <QImage>
+#include <QVector>
+
+struct PixelGrid
+{
+  bool found = false;
+  // Size of one source pixel in screen pixels
+  int scale = 1;
+  // Position of the first column and row where a source pixel starts. Only
+  // known for axes that had enough transitions
+  bool hasPhaseX = false;
+  bool hasPhaseY = false;
+  int phaseX = 0;
+  int phaseY = 0;
+};
+
+// Finds the integer upscale factor and phase of pixel-art content. Counts
+// where neighbouring screen pixels differ, per column and per row, and picks
+// the largest scale for which nearly all of those transitions land on the
+// same phase. If the few transitions off that grid line up on the grid of a
+// divisor, the divisor is the real scale. Axes with too few transitions to
+// tell are left out
+class GridDetector
+{
+public:
+  GridDetector();
+  ~GridDetector();
+  // The image is an unscaled grab. Returns false if no grid above 1 was found
+  bool detect(const QImage &image, PixelGrid &grid);
+  qint64 lastNsecs() const;
+
+private:
+  // Share of the transitions that fall on the best phase for the scale
+  double score(const QVector<int> &transitions, const int &scale, int &phase) const;
+  QVector<int> columns;
+  QVector<int> rows;
+  qint64 nsecs = 0;
+
+};
+
+#endif // __GRIDDETECTOR_H__
@@ -0,0 +1,203 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            headlesscapture.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "headlesscapture.h"
+#include "ledanimation.h"
+#include "profiler.h"
+
+#include <stdio.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+HeadlessCapture::HeadlessCapture(const CaptureConfig &config, const HeadlessOptions &options, QObject *parent)
+  : QObject(parent), options(options), configStore(config), frames(options.pixelFormat)
+{
+  frames.setDeduplicate(options.deduplicate);
+  for(int idx = 0; idx < config.regions.count(); ++idx) {
+    regionFrames.append(new FrameStore(options.pixelFormat));
+    regionFrames.last()->setDeduplicate(options.deduplicate);
+  }
+
+  exporter = new Exporter(this);
+  connect(exporter, &Exporter::finished, this, &HeadlessCapture::exportFinished);
+
+  // The worker outlives the capture thread, its queues are drained after the
+  // thread has stopped
+  cursorTracker = new CursorTracker(configStore, this);
+  worker = new CaptureWorker(configStore, *cursorTracker);
+  // Nothing shows the preview, and holding on to preview images would keep
+  // the back buffer from recycling its slots
+  worker->setPreview(false);
+  worker->setRecording(true);
+  worker->moveToThread(&captureThread);
+  captureThread.setObjectName("capture");
+  connect(worker, &CaptureWorker::framesAvailable, this, &HeadlessCapture::consumeFrames);
+
+  durationTimer.setSingleShot(true);
+  connect(&durationTimer, &QTimer::timeout, this, &HeadlessCapture::finishCapture);
+}
+
+HeadlessCapture::~HeadlessCapture()
+{
+  stopCapture();
+  delete worker;
+  qDeleteAll(regionFrames);
+}
+
+void HeadlessCapture::start()
+{
+  capturing = true;
+  clock.start();
+  captureThread.start();
+  QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection);
+  if(options.durationMs > 0) {
+    durationTimer.start(options.durationMs);
+  }
+}
+
+void HeadlessCapture::consumeFrames()
+{
+  worker->acknowledgeFrames();
+  if(Profiler::isEnabled()) {
+    Profiler::collect();
+  }
+  if(capturing && drainFrames()) {
+    finishCapture();
+  }
+}
+
+bool HeadlessCapture::drainFrames()
+{
+  CapturedFrame captured;
+  while(!limitReached() && worker->recordQueue.pop(captured)) {
+    ProfileScope scope(Profiler::Append);
+    frames.append(captured.image, captured.timestamp);
+    for(int idx = 0; idx < regionFrames.count(); ++idx) {
+      regionFrames.at(idx)->append(captured.regions.value(idx), captured.timestamp);
+    }
+  }
+  return limitReached();
+}
+
+bool HeadlessCapture::limitReached() const
+{
+  return options.frameCount > 0 && frames.totalTicks() >= options.frameCount;
+}
+
+void HeadlessCapture::stopCapture()
+{
+  durationTimer.stop();
+  if(captureThread.isRunning()) {
+    QMetaObject::invokeMethod(worker, "stop", Qt::BlockingQueuedConnection);
+    captureThread.quit();
+    captureThread.wait();
+  }
+}
+
+void HeadlessCapture::finishCapture()
+{
+  if(!capturing) {
+    return;
+  }
+  capturing = false;
+  stopCapture();
+  // Frames recorded while the worker was being stopped still count
+  drainFrames();
+  exportFrames();
+}
+
+void HeadlessCapture::exportFrames()
+{
+  const double seconds = clock.nsecsElapsed() / 1000000000.0;
+  printf("Captured %d frames (%d unique) in %.2f s, %.2f fps, %d dropped, %d ticks skipped\n",
+         frames.totalTicks(), frames.count(), seconds, frames.totalTicks() / seconds,
+         worker->recordQueue.dropped(), worker->skippedTicks());
+  if(configStore.current().motionCompensation) {
+    printf("Motion estimation took %.3f ms for the last frame\n", worker->motionEstimateNsecs() / 1000000.0);
+  }
+  if(frames.isEmpty()) {
+    printf("No frames were captured\n");
+    emit finished(1);
+    return;
+  }
+
+  const QVector<CaptureRegion> &regions = configStore.current().regions;
+  PostProcess postProcess;
+  postProcess.configure(configStore.current());
+  const QVector<int> holds = frames.holdsAt(options.exportFps, configStore.current().fps);
+  if(options.format == "rgla" || options.format == "h" || options.format == "gif" || options.format == "apng") {
+    QFileInfo(options.output).absoluteDir().mkpath(".");
+    // Each region goes next to the main animation in a file of its own
+    bool saved = true;
+    for(int idx = -1; idx < regionFrames.count(); ++idx) {
+      const FrameStore &store = idx < 0?frames:*regionFrames.at(idx);
+      const QString fileName = idx < 0?options.output:Exporter::regionFileName(options.output, regions.at(idx).name);
+      const QVector<int> durations = LedAnimation::durations(store.holdsAt(options.exportFps, configStore.current().fps),
+                                                             options.exportFps > 0?options.exportFps:configStore.current().fps);
+      if(!LedAnimation::saveAs(options.format, fileName, store, durations, &postProcess)) {
+        printf("The LED animation could not be written to '%s'\n", qPrintable(fileName));
+        saved = false;
+      }
+    }
+    emit finished(saved?0:1);
+  } else if(options.format == "png") {
+    QDir exportDir(options.output);
+    if(!exportDir.mkpath(exportDir.absolutePath())) {
+      printf("The export path '%s' could not be created\n", qPrintable(options.output));
+      emit finished(1);
+      return;
+    }
+    // Regions are exported to a subdirectory each
+    QVector<ExportSet> sets({{&frames, holds, exportDir.absolutePath()}});
+    for(int idx = 0; idx < regionFrames.count(); ++idx) {
+      const QString path = exportDir.absoluteFilePath(regions.at(idx).name);
+      if(!QDir().mkpath(path)) {
+        printf("The export path '%s' could not be created\n", qPrintable(path));
+        emit finished(1);
+        return;
+      }
+      sets.append({regionFrames.at(idx), regionFrames.at(idx)->holdsAt(options.exportFps, configStore.current().fps), path});
+    }
+    // There is nobody to ask, so an existing export is always replaced
+    for(const auto &set: sets) {
+      for(const auto &fileName: Exporter::existingFrames(set.path, "frame")) {
+        QFile::remove(QDir(set.path).absoluteFilePath(fileName));
+      }
+    }
+    clock.restart();
+    exporter->setPostProcess(postProcess);
+    exporter->start(sets, "frame");
+  } else {
+    emit finished(0);
+  }
+}
+
+void HeadlessCapture::exportFinished(bool cancelled)
+{
+  printf("Exported %d files in %.2f s\n", exporter->writtenFiles(), clock.nsecsElapsed() / 1000000000.0);
+  emit finished(cancelled?1:0);
+}
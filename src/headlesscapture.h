@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            headlesscapture.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __HEADLESSCAPTURE_H__
+#define __HEADLESSCAPTURE_H__
+
+#include "captureworker.h"
+#include "captureconfig.h"
+#include "exporter.h"
+#include "framestore.h"
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+
+struct HeadlessOptions
+{
+  // Capture stops at whichever limit is reached first, 0 means no limit
+  int frameCount = 0;
+  int durationMs = 0;
+  QString format = "png";
+  QString output = "./export";
+  FrameStore::PixelFormat pixelFormat = FrameStore::Rgb888;
+  bool deduplicate = true;
+  // Resample the recorded timeline to this rate on export, 0 keeps the ticks
+  int exportFps = 0;
+};
+
+// Runs the capture, crop, store and export pipeline without any widgets.
+// Records from the first tick and emits finished() with the exit code once
+// the frames have been exported
+class HeadlessCapture : public QObject
+{
+  Q_OBJECT
+
+public:
+  HeadlessCapture(const CaptureConfig &config, const HeadlessOptions &options, QObject *parent = nullptr);
+  ~HeadlessCapture();
+
+public slots:
+  void start();
+
+signals:
+  void finished(int exitCode);
+
+private slots:
+  void consumeFrames();
+  void finishCapture();
+  void exportFinished(bool cancelled);
+
+private:
+  bool drainFrames();
+  bool limitReached() const;
+  void stopCapture();
+  void exportFrames();
+  HeadlessOptions options;
+  CaptureConfigStore configStore;
+  QThread captureThread;
+  CursorTracker *cursorTracker = nullptr;
+  CaptureWorker *worker = nullptr;
+  Exporter *exporter = nullptr;
+  QTimer durationTimer;
+  QElapsedTimer clock;
+  bool capturing = false;
+  FrameStore frames;
+  // One per capture region, in the order of the config
+  QVector<FrameStore *> regionFrames;
+
+};
+
+#endif // __HEADLESSCAPTURE_H__
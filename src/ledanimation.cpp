@@ -0,0 +1,274 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            ledanimation.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "ledanimation.h"
+#include "animatedexport.h"
+#include "postprocess.h"
+#include "profiler.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QtConcurrent>
+
+#include <string.h>
+
+namespace
+{
+  const char magic[4] = {'R', 'G', 'L', 'A'};
+  const int version = 1;
+  const int headerSize = 32;
+  // Frames corrected in parallel before they are written
+  const int chunkFrames = 64;
+
+  template <typename T>
+  void put(QByteArray &data, const int &offset, const T &value)
+  {
+    qToLittleEndian<T>(value, data.data() + offset);
+  }
+
+  template <typename T>
+  T get(const uchar *data, const qint64 &offset)
+  {
+    return qFromLittleEndian<T>(data + offset);
+  }
+
+  int align(const int &offset, const int &alignment)
+  {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+}
+
+bool LedAnimation::saveAs(const QString &format, const QString &fileName, const FrameStore &frames,
+                          const QVector<int> &durations, const PostProcess *postProcess)
+{
+  ProfileScope scope(Profiler::Encode);
+  if(format == "h") {
+    return saveHeader(fileName, frames, durations, postProcess);
+  } else if(format == "gif") {
+    return AnimatedExport::saveGif(fileName, frames, durations, postProcess);
+  } else if(format == "apng") {
+    return AnimatedExport::saveApng(fileName, frames, durations, postProcess);
+  }
+  return save(fileName, frames, durations, postProcess);
+}
+
+QString LedAnimation::formatFromFileName(const QString &fileName)
+{
+  const QString suffix = QFileInfo(fileName).suffix().toLower();
+  if(suffix == "h" || suffix == "gif") {
+    return suffix;
+  } else if(suffix == "apng" || suffix == "png") {
+    return "apng";
+  }
+  return "rgla";
+}
+
+QVector<int> LedAnimation::durations(const QVector<int> &holds, const int &fps)
+{
+  // Rounded on the running total, so fractional tick lengths like 16.67 ms
+  // at 60 fps don't accumulate into drift
+  QVector<int> durations(holds.count());
+  qint64 ticks = 0;
+  for(int idx = 0; idx < holds.count(); ++idx) {
+    const qint64 start = qRound64((ticks * 1000.0) / qMax(1, fps));
+    ticks += holds.at(idx);
+    durations[idx] = qRound64((ticks * 1000.0) / qMax(1, fps)) - start;
+  }
+  return durations;
+}
+
+bool LedAnimation::serialize(const FrameStore &frames, const QVector<int> &durations, const Sink &sink,
+                             const PostProcess *postProcess)
+{
+  // Durations are 16 bit, so a frame held for longer is stored as several
+  // entries that add up to its duration
+  QVector<int> included;
+  QVector<int> includedDurations;
+  for(int idx = 0; idx < frames.count(); ++idx) {
+    for(int duration = durations.value(idx); duration > 0; duration -= 65535) {
+      included.append(idx);
+      includedDurations.append(qMin(duration, 65535));
+    }
+  }
+  const qint64 frameBytes = frames.frameBytes();
+  const int durationsOffset = headerSize;
+  const int dataOffset = align(durationsOffset + (included.count() * 2), 16);
+  const qint64 size = dataOffset + (included.count() * frameBytes);
+
+  QByteArray header(dataOffset, '\0');
+  memcpy(header.data(), magic, 4);
+  put<quint16>(header, 4, version);
+  put<quint16>(header, 6, headerSize);
+  put<quint16>(header, 8, frames.frameSize().width());
+  put<quint16>(header, 10, frames.frameSize().height());
+  put<quint8>(header, 12, frames.pixelFormat());
+  put<quint8>(header, 13, FrameStore::bytesPerPixel(frames.pixelFormat()));
+  put<quint32>(header, 16, included.count());
+  put<quint32>(header, 20, frameBytes);
+  put<quint32>(header, 24, durationsOffset);
+  put<quint32>(header, 28, dataOffset);
+  for(int idx = 0; idx < included.count(); ++idx) {
+    put<quint16>(header, durationsOffset + (idx * 2), includedDurations.at(idx));
+  }
+  if(!sink(header.constData(), header.size(), size)) {
+    return false;
+  }
+
+  // Frames go out one chunk at a time, so only a chunk is ever held in
+  // memory, and frames that were dropped to the journal are read back as
+  // they are written
+  if(postProcess == nullptr || postProcess->isIdentity()) {
+    for(int idx = 0; idx < included.count(); ++idx) {
+      if(!sink((const char *)frames.frameData(included.at(idx)), frameBytes, size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  // Corrected frames are packed in parallel into the chunk
+  QByteArray chunk;
+  QVector<int> positions;
+  const FrameStore::PixelFormat pixelFormat = frames.pixelFormat();
+  for(int begin = 0; begin < included.count(); begin += chunkFrames) {
+    const int end = qMin(begin + chunkFrames, included.count());
+    positions.resize(end - begin);
+    for(int idx = 0; idx < positions.count(); ++idx) {
+      positions[idx] = begin + idx;
+    }
+    chunk.resize(positions.count() * frameBytes);
+    uchar *chunkData = (uchar *)chunk.data();
+    QtConcurrent::blockingMap(positions, [&frames, &included, postProcess, chunkData, frameBytes, pixelFormat,
+                                          begin](int &position) {
+      QImage corrected;
+      postProcess->apply(frames.frame(included.at(position)), corrected);
+      FrameStore::pack(corrected, pixelFormat, chunkData + ((position - begin) * frameBytes));
+    });
+    if(!sink(chunk.constData(), chunk.size(), size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LedAnimation::save(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                        const PostProcess *postProcess)
+{
+  if(frames.isEmpty()) {
+    return false;
+  }
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  return serialize(frames, durations, [&file](const char *data, const qint64 &bytes, const qint64 &) {
+    return file.write(data, bytes) == bytes;
+  }, postProcess);
+}
+
+bool LedAnimation::saveHeader(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                              const PostProcess *postProcess)
+{
+  if(frames.isEmpty()) {
+    return false;
+  }
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    return false;
+  }
+  QString name = QFileInfo(fileName).completeBaseName().toLower();
+  for(auto &character: name) {
+    if(!character.isLetterOrNumber()) {
+      character = '_';
+    }
+  }
+  if(name.isEmpty() || name.at(0).isDigit()) {
+    name.prepend("anim_");
+  }
+  // The array is written as the data comes in, the size is known up front
+  static const char digits[] = "0123456789abcdef";
+  qint64 written = 0;
+  QByteArray text;
+  const bool serialized = serialize(frames, durations, [&](const char *data, const qint64 &bytes, const qint64 &size) {
+    text.clear();
+    if(written == 0) {
+      text.append("/* RetroGrab LED animation, see ledanimation.h in RetroGrab for the layout */\n");
+      text.append("#define " + name.toUpper().toUtf8() + "_SIZE " + QByteArray::number(size) + "\n");
+      text.append("#ifdef __GNUC__\n__attribute__((aligned(16)))\n#endif\n");
+      text.append("static const unsigned char " + name.toUtf8() + "[" + QByteArray::number(size) + "] = {");
+    }
+    for(qint64 idx = 0; idx < bytes; ++idx) {
+      const uchar value = data[idx];
+      text.append((written + idx) % 16 == 0 ? "\n  0x" : " 0x");
+      text.append(digits[value >> 4]);
+      text.append(digits[value & 0xf]);
+      text.append(',');
+    }
+    written += bytes;
+    return file.write(text) == text.size();
+  }, postProcess);
+  if(!serialized) {
+    return false;
+  }
+  const QByteArray end("\n};\n");
+  return file.write(end) == end.size();
+}
+
+bool LedAnimation::load(const QString &fileName, FrameStore &frames, const int &tickMs)
+{
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly) || file.size() < headerSize) {
+    return false;
+  }
+  const uchar *data = file.map(0, file.size());
+  if(data == nullptr ||
+     memcmp(data, magic, 4) != 0 ||
+     get<quint16>(data, 4) != version) {
+    return false;
+  }
+  const QSize frameSize(get<quint16>(data, 8), get<quint16>(data, 10));
+  const int pixelFormat = get<quint8>(data, 12);
+  const qint64 frameCount = get<quint32>(data, 16);
+  const qint64 frameBytes = get<quint32>(data, 20);
+  const qint64 durationsOffset = get<quint32>(data, 24);
+  const qint64 dataOffset = get<quint32>(data, 28);
+  if(pixelFormat > FrameStore::Rgb332 ||
+     frameBytes != (qint64)frameSize.width() * frameSize.height() * FrameStore::bytesPerPixel((FrameStore::PixelFormat)pixelFormat) ||
+     durationsOffset + (frameCount * 2) > file.size() ||
+     dataOffset + (frameCount * frameBytes) > file.size()) {
+    return false;
+  }
+
+  frames.setPixelFormat((FrameStore::PixelFormat)pixelFormat);
+  qint64 timestamp = 0;
+  for(qint64 idx = 0; idx < frameCount; ++idx) {
+    const int duration = get<quint16>(data, durationsOffset + (idx * 2));
+    const int hold = qMax(1, qRound(duration / (double)qMax(1, tickMs)));
+    frames.appendPacked(frameSize, data + dataOffset + (idx * frameBytes), hold, timestamp);
+    timestamp += duration * 1000000LL;
+  }
+  return true;
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            ledanimation.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __LEDANIMATION_H__
+#define __LEDANIMATION_H__
+
+#include "framestore.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+#include <functional>
+
+class PostProcess;
+
+// Single file LED animation. All fields are little endian:
+//
+//   0  char[4]  magic "RGLA"
+//   4  uint16   version
+//   6  uint16   header size in bytes
+//   8  uint16   frame width
+//  10  uint16   frame height
+//  12  uint8    pixel format (0 = rgb32, 1 = rgb888, 2 = rgb565, 3 = rgb332)
+//  13  uint8    bytes per pixel
+//  14  uint16   reserved
+//  16  uint32   frame count
+//  20  uint32   bytes per frame
+//  24  uint32   offset of the uint16 per-frame durations in milliseconds
+//  28  uint32   offset of the frame data, 16 byte aligned
+//
+// The frame data is the frames packed back to back in the given pixel format,
+// rows top to bottom without padding. rgb888 is stored as R, G, B bytes, rgb565
+// and rgb32 as little endian words and rgb332 as RRRGGGBB bytes. Frames are
+// copied from the store as is, so the writing host must be little endian
+namespace LedAnimation
+{
+  // Frames with a duration of 0 are left out, frames longer than 65535 ms
+  // are repeated. With a post process each frame is corrected on its way
+  // into the file, the store is left as is. The sink receives the file piece
+  // by piece along with its total size in bytes, returning false stops it
+  typedef std::function<bool(const char *data, const qint64 &bytes, const qint64 &size)> Sink;
+  bool serialize(const FrameStore &frames, const QVector<int> &durations, const Sink &sink,
+                 const PostProcess *postProcess = nullptr);
+  bool save(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+            const PostProcess *postProcess = nullptr);
+  bool saveHeader(const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+                  const PostProcess *postProcess = nullptr);
+  // 'rgla', 'h', 'gif' or 'apng', the latter two through AnimatedExport
+  bool saveAs(const QString &format, const QString &fileName, const FrameStore &frames, const QVector<int> &durations,
+              const PostProcess *postProcess = nullptr);
+  // Picks the format by suffix, anything unknown is saved as RGLA
+  QString formatFromFileName(const QString &fileName);
+  // Hold counts are turned into durations and back using the given tick length
+  QVector<int> durations(const QVector<int> &holds, const int &fps);
+  bool load(const QString &fileName, FrameStore &frames, const int &tickMs);
+}
+
+#endif // __LEDANIMATION_H__
@@ -0,0 +1,228 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            ledstreamer.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "ledstreamer.h"
+#include "pixelconvert.h"
+
+#include <QUdpSocket>
+#include <QHostInfo>
+#include <QtEndian>
+#include <QElapsedTimer>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+  // DDP, see http://www.3waylabs.com/ddp/
+  const int ddpHeaderSize = 10;
+  const int ddpTimecodeSize = 4;
+  const int ddpMaxData = 1440;
+  const quint8 ddpVersion1 = 0x40;
+  const quint8 ddpFlagTimecode = 0x10;
+  const quint8 ddpFlagPush = 0x01;
+  const quint8 ddpTypeRgb24 = 0x0b;
+  const quint8 ddpIdDisplay = 0x01;
+
+  // E1.31 (sACN) data packet, ANSI E1.31-2018
+  const int e131HeaderSize = 126;
+  const int e131MaxSlots = 510;
+  const char e131Identifier[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+  const char e131Cid[16] = {'R', 'e', 't', 'r', 'o', 'G', 'r', 'a', 'b', '-', 'L', 'E', 'D', '-', '0', '1'};
+
+  // Delay before a failed host name lookup is tried again
+  const int lookupRetryMs = 5000;
+}
+
+LedStreamer::LedStreamer()
+{
+}
+
+LedStreamer::~LedStreamer()
+{
+  delete socket;
+}
+
+void LedStreamer::configure(const CaptureConfig &config)
+{
+  if(socket == nullptr) {
+    // Created here so it belongs to the capture thread
+    socket = new QUdpSocket();
+  }
+  if(config.streamHost != host) {
+    host = config.streamHost;
+    address = QHostAddress(host);
+    lookupPending = false;
+    lookupTimer.invalidate();
+  }
+  // Host names are resolved in the background so a slow name server never
+  // stalls the capture tick. The result arrives in this thread through the
+  // socket's event loop. Failed lookups are retried every few seconds
+  if(address.isNull() && !host.isEmpty() && !lookupPending &&
+     (!lookupTimer.isValid() || lookupTimer.hasExpired(lookupRetryMs))) {
+    lookupPending = true;
+    const QString name = host;
+    QHostInfo::lookupHost(name, socket, [this, name](const QHostInfo &info) {
+      // Answers for a host that has been changed since are ignored
+      if(name != host) {
+        return;
+      }
+      lookupPending = false;
+      lookupTimer.start();
+      if(info.error() == QHostInfo::NoError && !info.addresses().isEmpty()) {
+        address = info.addresses().first();
+      } else {
+        printf("Could not resolve LED streaming host '%s', retrying\n", qPrintable(name));
+      }
+    });
+  }
+  if(config.streamProtocol != protocol ||
+     config.streamUniverse != universe ||
+     config.streamTimecode != timecode) {
+    protocol = config.streamProtocol;
+    universe = config.streamUniverse;
+    timecode = config.streamTimecode;
+    size = QSize();
+  }
+  port = config.streamPort;
+  postProcess.configure(config);
+}
+
+void LedStreamer::prepare(const QSize &frameSize)
+{
+  // Packet headers are only built when the frame geometry or protocol changes.
+  // Per frame only the pixel data and sequence numbers are written
+  size = frameSize;
+  rgb.resize(size.width() * size.height() * 3);
+  packets.clear();
+  if(protocol == CaptureConfig::Ddp) {
+    const int headerSize = ddpHeaderSize + (timecode?ddpTimecodeSize:0);
+    for(int offset = 0; offset < rgb.size(); offset += ddpMaxData) {
+      const int length = qMin(ddpMaxData, rgb.size() - offset);
+      QByteArray packet(headerSize + length, '\0');
+      uchar *data = (uchar *)packet.data();
+      data[0] = ddpVersion1 | (timecode?ddpFlagTimecode:0) | (offset + length == rgb.size()?ddpFlagPush:0);
+      data[2] = ddpTypeRgb24;
+      data[3] = ddpIdDisplay;
+      qToBigEndian<quint32>(offset, data + 4);
+      qToBigEndian<quint16>(length, data + 8);
+      packets.append(packet);
+    }
+  } else {
+    for(int offset = 0; offset < rgb.size(); offset += e131MaxSlots) {
+      const int slotCount = qMin(e131MaxSlots, rgb.size() - offset);
+      QByteArray packet(e131HeaderSize + slotCount, '\0');
+      uchar *data = (uchar *)packet.data();
+      qToBigEndian<quint16>(0x0010, data);
+      memcpy(data + 4, e131Identifier, 12);
+      qToBigEndian<quint16>(0x7000 | (packet.size() - 16), data + 16);
+      qToBigEndian<quint32>(0x00000004, data + 18);
+      memcpy(data + 22, e131Cid, 16);
+      qToBigEndian<quint16>(0x7000 | (packet.size() - 38), data + 38);
+      qToBigEndian<quint32>(0x00000002, data + 40);
+      strncpy((char *)data + 44, "RetroGrab", 63);
+      data[108] = 100;
+      qToBigEndian<quint16>(universe + (offset / e131MaxSlots), data + 113);
+      qToBigEndian<quint16>(0x7000 | (packet.size() - 115), data + 115);
+      data[117] = 0x02;
+      data[118] = 0xa1;
+      qToBigEndian<quint16>(0x0001, data + 121);
+      qToBigEndian<quint16>(slotCount + 1, data + 123);
+      packets.append(packet);
+    }
+  }
+}
+
+void LedStreamer::send(const QImage &frame)
+{
+  if(socket == nullptr || address.isNull() || frame.isNull()) {
+    return;
+  }
+  if(frame.size() != size) {
+    prepare(frame.size());
+  }
+  QImage source = (frame.format() == QImage::Format_RGB32 ||
+                   frame.format() == QImage::Format_ARGB32 ||
+                   frame.format() == QImage::Format_ARGB32_Premultiplied)?frame:frame.convertToFormat(QImage::Format_RGB32);
+  if(!postProcess.isIdentity()) {
+    postProcess.apply(source, corrected);
+    source = corrected;
+  }
+  uchar *dst = (uchar *)rgb.data();
+  for(int y = 0; y < size.height(); ++y) {
+    PixelConvert::toRgb888((const quint32 *)source.constScanLine(y), dst, size.width());
+    dst += size.width() * 3;
+  }
+  if(protocol == CaptureConfig::Ddp) {
+    sendDdp();
+  } else {
+    sendE131();
+  }
+}
+
+void LedStreamer::sendDdp()
+{
+  // DDP sequence numbers run from 1 to 15, 0 means not used
+  sequence = (sequence % 15) + 1;
+  quint32 timecodeValue = 0;
+  if(timecode) {
+    // Monotonic clock as 16.16 fixed point seconds, so a receiver on the same
+    // host can measure the latency
+    QElapsedTimer now;
+    now.start();
+    const qint64 msecs = now.msecsSinceReference();
+    timecodeValue = ((quint32)(msecs / 1000) << 16) | (quint32)(((msecs % 1000) << 16) / 1000);
+  }
+  const int headerSize = ddpHeaderSize + (timecode?ddpTimecodeSize:0);
+  int offset = 0;
+  for(auto &packet: packets) {
+    uchar *data = (uchar *)packet.data();
+    const int length = packet.size() - headerSize;
+    data[1] = sequence;
+    if(timecode) {
+      qToBigEndian<quint32>(timecodeValue, data + ddpHeaderSize);
+    }
+    memcpy(data + headerSize, rgb.constData() + offset, length);
+    offset += length;
+    // Non-blocking, a full socket buffer just drops the packet
+    socket->writeDatagram(packet, address, port);
+  }
+}
+
+void LedStreamer::sendE131()
+{
+  // E1.31 sequence numbers wrap at 255 and are shared by all universes
+  sequence++;
+  int offset = 0;
+  for(auto &packet: packets) {
+    uchar *data = (uchar *)packet.data();
+    const int slotCount = packet.size() - e131HeaderSize;
+    data[111] = sequence;
+    memcpy(data + e131HeaderSize, rgb.constData() + offset, slotCount);
+    offset += slotCount;
+    socket->writeDatagram(packet, address, port);
+  }
+}
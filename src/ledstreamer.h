@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            ledstreamer.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __LEDSTREAMER_H__
+#define __LEDSTREAMER_H__
+
+#include "captureconfig.h"
+#include "postprocess.h"
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+class QUdpSocket;
+
+// Sends frames to an LED matrix as DDP or E1.31 (sACN) packets. Lives in the
+// capture thread and sends each frame from the capture tick that produced it
+class LedStreamer
+{
+public:
+  LedStreamer();
+  ~LedStreamer();
+  void configure(const CaptureConfig &config);
+  void send(const QImage &frame);
+
+private:
+  void prepare(const QSize &frameSize);
+  void sendDdp();
+  void sendE131();
+  QUdpSocket *socket = nullptr;
+  CaptureConfig::StreamProtocol protocol = CaptureConfig::Ddp;
+  QString host;
+  QHostAddress address;
+  bool lookupPending = false;
+  // Started when the last lookup finished, for retrying failed ones
+  QElapsedTimer lookupTimer;
+  int port = 0;
+  int universe = 1;
+  bool timecode = false;
+  QSize size;
+  QByteArray rgb;
+  QVector<QByteArray> packets;
+  quint8 sequence = 0;
+  PostProcess postProcess;
+  QImage corrected;
+
+};
+
+#endif // __LEDSTREAMER_H__
@@ -25,14 +25,190 @@
  */
 
 #include <QApplication>
+#include <QGuiApplication>
+#include <QCommandLineParser>
 #include <QDir>
 #include <QSettings>
 #include <QStyleFactory>
 
+#include <stdio.h>
+#include <string.h>
+
 #include "window.h"
+#include "headlesscapture.h"
+#include "profiler.h"
+
+static bool parseSize(const QString &value, int &width, int &height)
+{
+  const QStringList parts = value.split('x');
+  bool widthOk = false;
+  bool heightOk = false;
+  if(parts.count() == 2) {
+    width = parts.at(0).toInt(&widthOk);
+    height = parts.at(1).toInt(&heightOk);
+  }
+  return widthOk && heightOk && width > 0 && height > 0;
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+  // No widgets are created, so this also runs with QT_QPA_PLATFORM=offscreen
+  // or on an Xvfb display
+  QGuiApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Captures and exports frames without opening any windows.");
+  parser.addHelpOption();
+  parser.addOptions({
+      {"headless", "Run without a user interface."},
+      {"config", "Read the capture settings from this ini file. It is never written to.", "file"},
+      {"source", "Capture source: auto, qt, xshm, synthetic or file:<image or animation>.", "source"},
+      {"rect", "Capture a fixed screen rectangle instead of following the cursor.", "x,y,width,height"},
+      {"viewport", "Viewport size when following the cursor.", "widthxheight"},
+      {"divider", "Viewport scale divider.", "divider"},
+      {"downscale", "Downscale mode: nearest or box.", "mode"},
+      {"grab", "Size of the grabbed frames, defaults to the whole rectangle with --rect.", "widthxheight"},
+      {"regions", "Extra regions cut from the same grab, see grab/regions in the README.", "name=x,y,width,height;..."},
+      {"fps", "Capture rate in frames per second.", "fps"},
+      {"look-ahead", "Grab look-ahead in frames.", "frames"},
+      {"roi", "Only capture the grab region plus a margin."},
+      {"adaptive", "Only probe the recorded area, at a lower rate, while nothing changes."},
+      {"motion", "Let the look-ahead crop follow the estimated content motion."},
+      {"motion-search", "Motion search radius in viewport pixels.", "pixels"},
+      {"frames", "Stop after this many frames.", "count"},
+      {"duration", "Stop after this many seconds.", "seconds"},
+      {"format", "png, rgla, h, gif, apng or none.", "format", "png"},
+      {"export-fps", "Resample the recorded timeline to exactly this frame rate on export.", "fps"},
+      {"output", "Export directory for png, file name otherwise.", "path", "./export"},
+      {"pixel-format", "rgb32, rgb888, rgb565 or rgb332.", "format"},
+      {"no-dedup", "Store identical consecutive frames separately."},
+      {"trace", "Time the pipeline stages and save them as a Chrome trace.", "file"}
+    });
+  parser.process(app);
+
+  CaptureConfig config;
+  QString pixelFormat = "rgb888";
+  bool deduplicate = true;
+  if(parser.isSet("config")) {
+    QSettings settings(parser.value("config"), QSettings::IniFormat);
+    config.load(settings);
+    pixelFormat = settings.value("grab/pixelFormat", pixelFormat).toString();
+    deduplicate = settings.value("grab/dedup", deduplicate).toBool();
+  }
+  if(parser.isSet("source")) {
+    config.captureSource = parser.value("source");
+  }
+  if(parser.isSet("downscale")) {
+    config.downscaleMode = Downscale::modeFromName(parser.value("downscale"));
+  }
+  if(parser.isSet("divider")) {
+    config.divider = qMax(1, parser.value("divider").toInt());
+  }
+  if(parser.isSet("viewport") &&
+     !parseSize(parser.value("viewport"), config.viewportWidth, config.viewportHeight)) {
+    printf("Invalid --viewport '%s'\n", qPrintable(parser.value("viewport")));
+    return 1;
+  }
+  if(parser.isSet("rect")) {
+    const QStringList parts = parser.value("rect").split(',');
+    if(parts.count() != 4 || parts.at(2).toInt() < config.divider || parts.at(3).toInt() < config.divider) {
+      printf("Invalid --rect '%s'\n", qPrintable(parser.value("rect")));
+      return 1;
+    }
+    // The viewport is centered on the locked cursor position. Without snapping
+    // and alignment offsets it then covers exactly the rectangle, rounded down
+    // to a multiple of the divider
+    config.viewportWidth = parts.at(2).toInt() / config.divider;
+    config.viewportHeight = parts.at(3).toInt() / config.divider;
+    config.lockX = true;
+    config.lockY = true;
+    config.lockPosX = parts.at(0).toInt() + ((config.viewportWidth * config.divider) / 2);
+    config.lockPosY = parts.at(1).toInt() + ((config.viewportHeight * config.divider) / 2);
+    config.mouseSnap = false;
+    config.snapAlignmentX = 0;
+    config.snapAlignmentY = 0;
+    config.grabWidth = config.viewportWidth;
+    config.grabHeight = config.viewportHeight;
+  }
+  if(parser.isSet("grab") &&
+     !parseSize(parser.value("grab"), config.grabWidth, config.grabHeight)) {
+    printf("Invalid --grab '%s'\n", qPrintable(parser.value("grab")));
+    return 1;
+  }
+  if(parser.isSet("regions") &&
+     !CaptureConfig::parseRegions(parser.value("regions"), config.regions)) {
+    printf("Invalid --regions '%s'\n", qPrintable(parser.value("regions")));
+    return 1;
+  }
+  if(parser.isSet("fps")) {
+    config.fps = qBound(1, parser.value("fps").toInt(), 1000);
+  }
+  if(parser.isSet("look-ahead")) {
+    config.backBuffer = qMax(1, parser.value("look-ahead").toInt());
+  }
+  if(parser.isSet("roi")) {
+    config.roiCapture = true;
+  }
+  if(parser.isSet("adaptive")) {
+    config.adaptiveCapture = true;
+  }
+  if(parser.isSet("motion")) {
+    config.motionCompensation = true;
+  }
+  if(parser.isSet("motion-search")) {
+    config.motionSearch = qBound(1, parser.value("motion-search").toInt(), 32);
+  }
+
+  HeadlessOptions options;
+  options.frameCount = parser.value("frames").toInt();
+  options.durationMs = qRound(parser.value("duration").toDouble() * 1000.0);
+  options.format = parser.value("format");
+  options.exportFps = qMax(0, parser.value("export-fps").toInt());
+  options.output = parser.value("output");
+  options.pixelFormat = FrameStore::pixelFormatFromName(parser.isSet("pixel-format")?parser.value("pixel-format"):pixelFormat);
+  options.deduplicate = deduplicate && !parser.isSet("no-dedup");
+  if(options.frameCount <= 0 && options.durationMs <= 0) {
+    printf("Either --frames or --duration is needed\n");
+    return 1;
+  }
+  if(!QStringList({"png", "rgla", "h", "gif", "apng", "none"}).contains(options.format)) {
+    printf("Unknown --format '%s'\n", qPrintable(options.format));
+    return 1;
+  }
+
+  if(parser.isSet("trace")) {
+    Profiler::setEnabled(true);
+  }
+  HeadlessCapture capture(config, options);
+  QObject::connect(&capture, &HeadlessCapture::finished, &app, &QCoreApplication::exit, Qt::QueuedConnection);
+  capture.start();
+  const int exitCode = app.exec();
+  if(parser.isSet("trace")) {
+    Profiler::collect();
+    printf("%-12s %8s %8s\n", "stage", "p50 ms", "p99 ms");
+    for(int stage = 0; stage < Profiler::StageCount; ++stage) {
+      const Profiler::StageStats stats = Profiler::stats((Profiler::Stage)stage);
+      if(stats.count > 0) {
+        printf("%-12s %8.3f %8.3f\n", Profiler::stageName((Profiler::Stage)stage), stats.p50, stats.p99);
+      }
+    }
+    if(!Profiler::saveTrace(parser.value("trace"))) {
+      printf("The trace could not be written to '%s'\n", qPrintable(parser.value("trace")));
+      return 1;
+    }
+  }
+  return exitCode;
+}
 
 int main(int argc, char *argv[])
 {
+  // The application type has to be picked before the arguments can be parsed
+  for(int idx = 1; idx < argc; ++idx) {
+    if(strcmp(argv[idx], "--headless") == 0) {
+      return runHeadless(argc, argv);
+    }
+  }
+
   QApplication app(argc, argv);
   app.setStyle(QStyleFactory::create("Fusion"));
   
@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            motionestimator.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "motionestimator.h"
+
+#include <QElapsedTimer>
+
+#include <stdlib.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  // Stops early once the sum reaches the limit, the caller only needs to know
+  // that the candidate can't win
+  quint32 sad(const uchar *a, const int &strideA, const uchar *b, const int &strideB,
+              const int &bytes, const int &rows, const quint32 &limit)
+  {
+    quint32 total = 0;
+    for(int y = 0; y < rows; ++y) {
+      const uchar *lineA = a + (y * strideA);
+      const uchar *lineB = b + (y * strideB);
+      int x = 0;
+#ifdef __SSE2__
+      __m128i sum = _mm_setzero_si128();
+      for(; x + 16 <= bytes; x += 16) {
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(lineA + x)),
+                                              _mm_loadu_si128((const __m128i *)(lineB + x))));
+      }
+      total += _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#endif
+      for(; x < bytes; ++x) {
+        total += abs(lineA[x] - lineB[x]);
+      }
+      if(total >= limit) {
+        return total;
+      }
+    }
+    return total;
+  }
+}
+
+MotionEstimator::MotionEstimator()
+{
+}
+
+MotionEstimator::~MotionEstimator()
+{
+}
+
+bool MotionEstimator::estimate(const BackBufferSlot &previous, const BackBufferSlot &current,
+                               const QRect &region, const int &searchRadius, QPoint &motion)
+{
+  QElapsedTimer timer;
+  timer.start();
+  const QRect window = region.adjusted(-searchRadius, -searchRadius, searchRadius, searchRadius);
+  if(previous.image.depth() != 32 || current.image.depth() != 32 ||
+     !QRect(previous.offset, previous.image.size()).contains(window) ||
+     !QRect(current.offset, current.image.size()).contains(region)) {
+    nsecs = timer.nsecsElapsed();
+    return false;
+  }
+  const QPoint block = region.topLeft() - current.offset;
+  const uchar *currentBits = current.image.constScanLine(block.y()) + (block.x() * 4);
+  const int bytes = region.width() * 4;
+
+  // Content at p in the previous frame is found at p + motion in the current
+  // one. Ties go to the smaller displacement, so flat content doesn't drift
+  quint32 best = UINT_MAX;
+  int bestLength = 0;
+  for(int dy = -searchRadius; dy <= searchRadius; ++dy) {
+    for(int dx = -searchRadius; dx <= searchRadius; ++dx) {
+      const QPoint candidate = region.topLeft() - QPoint(dx, dy) - previous.offset;
+      const quint32 difference = sad(currentBits, current.image.bytesPerLine(),
+                                     previous.image.constScanLine(candidate.y()) + (candidate.x() * 4),
+                                     previous.image.bytesPerLine(),
+                                     bytes, region.height(), best == UINT_MAX?UINT_MAX:best + 1);
+      const int length = abs(dx) + abs(dy);
+      if(difference < best || (difference == best && length < bestLength)) {
+        best = difference;
+        bestLength = length;
+        motion = QPoint(dx, dy);
+      }
+    }
+  }
+  nsecs = timer.nsecsElapsed();
+  return true;
+}
+
+qint64 MotionEstimator::lastNsecs() const
+{
+  return nsecs;
+}
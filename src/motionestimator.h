@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            motionestimator.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __MOTIONESTIMATOR_H__
+#define __MOTIONESTIMATOR_H__
+
+#include "backbuffer.h"
+
+#include <QRect>
+#include <QPoint>
+
+// Block matching between consecutive back buffer frames. Finds how far the
+// content inside a region of the viewport moved since the previous frame by
+// minimizing the sum of absolute differences over a square search window
+class MotionEstimator
+{
+public:
+  MotionEstimator();
+  ~MotionEstimator();
+  // The region is in viewport coordinates. Returns false if either frame
+  // doesn't cover the region plus the search window
+  bool estimate(const BackBufferSlot &previous, const BackBufferSlot &current,
+                const QRect &region, const int &searchRadius, QPoint &motion);
+  qint64 lastNsecs() const;
+
+private:
+  qint64 nsecs = 0;
+
+};
+
+#endif // __MOTIONESTIMATOR_H__
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            pixelconvert.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "pixelconvert.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PIXELCONVERT_SSSE3
+#endif
+
+namespace
+{
+#ifdef PIXELCONVERT_SSSE3
+  // Returns the number of pixels converted, the rest is left to the caller
+  __attribute__((target("ssse3")))
+  int toRgb888Ssse3(const quint32 *src, uchar *dst, const int &count)
+  {
+    // B, G, R, A in memory becomes R, G, B. The last four bytes of each store
+    // are zero and overwritten by the following one, so the loop stops one
+    // group short of the end
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int a = 0;
+    for(; a + 8 <= count; a += 4) {
+      const __m128i pixels = _mm_loadu_si128((const __m128i *)(src + a));
+      _mm_storeu_si128((__m128i *)(dst + (a * 3)), _mm_shuffle_epi8(pixels, order));
+    }
+    return a;
+  }
+#endif
+}
+
+void PixelConvert::toRgb888(const quint32 *src, uchar *dst, const int &count)
+{
+  int a = 0;
+#ifdef PIXELCONVERT_SSSE3
+  static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+  if(hasSsse3) {
+    a = toRgb888Ssse3(src, dst, count);
+    dst += a * 3;
+  }
+#endif
+  for(; a < count; ++a) {
+    const quint32 pixel = src[a];
+    dst[0] = pixel >> 16;
+    dst[1] = pixel >> 8;
+    dst[2] = pixel;
+    dst += 3;
+  }
+}
+
+void PixelConvert::toRgb565(const quint32 *src, quint16 *dst, const int &count)
+{
+  int a = 0;
+#ifdef __SSE2__
+  const __m128i redMask = _mm_set1_epi32(0xf800);
+  const __m128i greenMask = _mm_set1_epi32(0x07e0);
+  const __m128i blueMask = _mm_set1_epi32(0x001f);
+  for(; a + 8 <= count; a += 8) {
+    __m128i pixels[2] = {
+      _mm_loadu_si128((const __m128i *)(src + a)),
+      _mm_loadu_si128((const __m128i *)(src + a + 4))
+    };
+    for(auto &p: pixels) {
+      p = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), redMask),
+                                    _mm_and_si128(_mm_srli_epi32(p, 5), greenMask)),
+                       _mm_and_si128(_mm_srli_epi32(p, 3), blueMask));
+      // Sign extend so the saturating pack below keeps all 16 bits
+      p = _mm_srai_epi32(_mm_slli_epi32(p, 16), 16);
+    }
+    _mm_storeu_si128((__m128i *)(dst + a), _mm_packs_epi32(pixels[0], pixels[1]));
+  }
+#endif
+  for(; a < count; ++a) {
+    const quint32 pixel = src[a];
+    dst[a] = ((pixel >> 8) & 0xf800) | ((pixel >> 5) & 0x07e0) | ((pixel >> 3) & 0x001f);
+  }
+}
+
+void PixelConvert::toRgb332(const quint32 *src, uchar *dst, const int &count)
+{
+  int a = 0;
+#ifdef __SSE2__
+  const __m128i redMask = _mm_set1_epi32(0xe0);
+  const __m128i greenMask = _mm_set1_epi32(0x1c);
+  const __m128i blueMask = _mm_set1_epi32(0x03);
+  for(; a + 16 <= count; a += 16) {
+    __m128i pixels[4];
+    for(int b = 0; b < 4; ++b) {
+      const __m128i p = _mm_loadu_si128((const __m128i *)(src + a + (b * 4)));
+      pixels[b] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), redMask),
+                                            _mm_and_si128(_mm_srli_epi32(p, 11), greenMask)),
+                               _mm_and_si128(_mm_srli_epi32(p, 6), blueMask));
+    }
+    _mm_storeu_si128((__m128i *)(dst + a),
+                     _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]),
+                                      _mm_packs_epi32(pixels[2], pixels[3])));
+  }
+#endif
+  for(; a < count; ++a) {
+    const quint32 pixel = src[a];
+    dst[a] = ((pixel >> 16) & 0xe0) | ((pixel >> 11) & 0x1c) | ((pixel >> 6) & 0x03);
+  }
+}
+
+const QVector<QRgb> &PixelConvert::rgb332Palette()
+{
+  static const QVector<QRgb> palette = []() {
+    QVector<QRgb> colors(256);
+    for(int idx = 0; idx < 256; ++idx) {
+      // Replicate the high bits so full intensity maps to 255
+      const int red = idx >> 5;
+      const int green = (idx >> 2) & 0x07;
+      const int blue = idx & 0x03;
+      colors[idx] = qRgb((red << 5) | (red << 2) | (red >> 1),
+                         (green << 5) | (green << 2) | (green >> 1),
+                         blue * 0x55);
+    }
+    return colors;
+  }();
+  return palette;
+}
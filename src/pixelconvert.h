@@ -0,0 +1,45 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            pixelconvert.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __PIXELCONVERT_H__
+#define __PIXELCONVERT_H__
+
+#include <QVector>
+#include <QColor>
+
+// Scanline kernels packing 0xAARRGGBB pixels into the LED panel formats. The
+// byte layouts match QImage::Format_RGB888, Format_RGB16 and an Indexed8 image
+// using the 3-3-2 palette below, so packed frames can be wrapped without
+// conversion for display and export
+namespace PixelConvert
+{
+  void toRgb888(const quint32 *src, uchar *dst, const int &count);
+  void toRgb565(const quint32 *src, quint16 *dst, const int &count);
+  void toRgb332(const quint32 *src, uchar *dst, const int &count);
+  const QVector<QRgb> &rgb332Palette();
+}
+
+#endif // __PIXELCONVERT_H__
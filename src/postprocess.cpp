@@ -0,0 +1,252 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            postprocess.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "postprocess.h"
+
+#include <QtMath>
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define POSTPROCESS_AVX2
+#endif
+
+namespace
+{
+  const int bayer[64] = {
+     0, 32,  8, 40,  2, 34, 10, 42,
+    48, 16, 56, 24, 50, 18, 58, 26,
+    12, 44,  4, 36, 14, 46,  6, 38,
+    60, 28, 52, 20, 62, 30, 54, 22,
+     3, 35, 11, 43,  1, 33,  9, 41,
+    51, 19, 59, 27, 49, 17, 57, 25,
+    15, 47,  7, 39, 13, 45,  5, 37,
+    63, 31, 55, 23, 61, 29, 53, 21
+  };
+
+  // Repeats the bits of a level so 0 and the maximum map to 0 and 255
+  inline uchar expand(const int &level, const int &bits)
+  {
+    int value = level << (8 - bits);
+    for(int shift = bits; shift < 8; shift += bits) {
+      value |= value >> shift;
+    }
+    return value;
+  }
+
+  // Table lookup of a row. Each channel has its own table, and the pixel at x
+  // looks up its values at offsets[x & 7] into them
+  void lookupRowScalar(const QRgb *src, QRgb *dst, const int &width, const uchar *red, const uchar *green,
+                       const uchar *blue, const int *offsets)
+  {
+    for(int x = 0; x < width; ++x) {
+      const int offset = offsets[x & 7];
+      const QRgb pixel = src[x];
+      dst[x] = qRgb(red[offset + qRed(pixel)], green[offset + qGreen(pixel)], blue[offset + qBlue(pixel)]);
+    }
+  }
+
+#ifdef POSTPROCESS_AVX2
+  // Gathers 32 bits at the byte offset of each entry and keeps the low byte
+  __attribute__((target("avx2")))
+  inline __m256i gatherBytes(const uchar *table, const __m256i &indices)
+  {
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int *)table, indices, 1), _mm256_set1_epi32(0xff));
+  }
+
+  __attribute__((target("avx2")))
+  void lookupRowAvx2(const QRgb *src, QRgb *dst, const int &width, const uchar *red, const uchar *green,
+                     const uchar *blue, const int *offsets)
+  {
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    // Eight pixels at a time starting at 0, so lane i is always at x & 7 == i
+    const __m256i lanes = _mm256_loadu_si256((const __m256i *)offsets);
+    int x = 0;
+    for(; x + 8 <= width; x += 8) {
+      const __m256i pixels = _mm256_loadu_si256((const __m256i *)(src + x));
+      const __m256i r = gatherBytes(red, _mm256_add_epi32(lanes, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask)));
+      const __m256i g = gatherBytes(green, _mm256_add_epi32(lanes, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask)));
+      const __m256i b = gatherBytes(blue, _mm256_add_epi32(lanes, _mm256_and_si256(pixels, mask)));
+      const __m256i result = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(r, 16)),
+                                             _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+      _mm256_storeu_si256((__m256i *)(dst + x), result);
+    }
+    lookupRowScalar(src + x, dst + x, width - x, red, green, blue, offsets);
+  }
+#endif
+}
+
+PostProcess::PostProcess()
+{
+  build();
+}
+
+PostProcess::~PostProcess()
+{
+}
+
+void PostProcess::configure(const CaptureConfig &config)
+{
+  int depth[3] = {8, 8, 8};
+  if(config.colorDepth.length() == 3) {
+    for(int channel = 0; channel < 3; ++channel) {
+      const int value = config.colorDepth.at(channel).digitValue();
+      depth[channel] = (value >= 1 && value <= 8)?value:8;
+    }
+  }
+  if(config.gamma == gamma &&
+     config.brightness == brightness &&
+     config.dither == dither &&
+     depth[0] == bits[0] && depth[1] == bits[1] && depth[2] == bits[2]) {
+    return;
+  }
+  gamma = config.gamma;
+  brightness = config.brightness;
+  dither = config.dither;
+  for(int channel = 0; channel < 3; ++channel) {
+    bits[channel] = depth[channel];
+  }
+  build();
+}
+
+void PostProcess::build()
+{
+  // Ordered dithering at full depth only adds fractions that are rounded
+  // away again, so it makes no difference either
+  identity = gamma == 10 && brightness == 100 && bits[0] == 8 && bits[1] == 8 && bits[2] == 8;
+  levels.resize(256);
+  for(int value = 0; value < 256; ++value) {
+    levels[value] = qRound(qPow(value / 255.0, gamma / 10.0) * (brightness / 100.0) * 65535.0);
+  }
+  for(int channel = 0; channel < 3; ++channel) {
+    const qint64 maxLevel = (1 << bits[channel]) - 1;
+    quantized[channel].fill(0, 256 + 3);
+    ordered[channel].fill(0, (64 * 256) + 3);
+    for(int value = 0; value < 256; ++value) {
+      quantized[channel][value] = expand(((levels.at(value) * maxLevel) + 32767) / 65535, bits[channel]);
+      for(int position = 0; position < 64; ++position) {
+        const qint64 threshold = (((bayer[position] * 2) + 1) * 65535) / 128;
+        ordered[channel][(position * 256) + value] = expand(((levels.at(value) * maxLevel) + threshold) / 65535, bits[channel]);
+      }
+    }
+  }
+}
+
+bool PostProcess::isIdentity() const
+{
+  return identity;
+}
+
+bool PostProcess::isSupported(const InstructionSet &instructionSet)
+{
+  switch(instructionSet) {
+  case Auto:
+  case Scalar:
+    return true;
+  case Avx2: {
+#ifdef POSTPROCESS_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+#else
+    return false;
+#endif
+  }
+  }
+  return false;
+}
+
+void PostProcess::apply(const QImage &source, QImage &destination, const InstructionSet &instructionSet) const
+{
+  const QImage input = (source.format() == QImage::Format_RGB32 ||
+                        source.format() == QImage::Format_ARGB32)?source:source.convertToFormat(QImage::Format_RGB32);
+  // When processing in place the input shares the pixels, so the image isn't
+  // detached and gets a buffer of its own
+  if(destination.size() != input.size() ||
+     destination.format() != QImage::Format_RGB32 ||
+     !destination.isDetached()) {
+    destination = QImage(input.size(), QImage::Format_RGB32);
+  }
+  const int width = input.width();
+  if(dither == CaptureConfig::FloydSteinberg && !identity) {
+    // Errors of the current and next row in 16 bit levels, with a guard
+    // column on either side
+    QVector<int> errors[2];
+    errors[0].fill(0, (width + 2) * 3);
+    errors[1].fill(0, (width + 2) * 3);
+    for(int y = 0; y < input.height(); ++y) {
+      const QRgb *src = (const QRgb *)input.constScanLine(y);
+      QRgb *dst = (QRgb *)destination.scanLine(y);
+      int *current = errors[y % 2].data();
+      int *next = errors[(y + 1) % 2].data();
+      memset(next, 0, errors[0].size() * sizeof(int));
+      for(int x = 0; x < width; ++x) {
+        const QRgb pixel = src[x];
+        const int inputs[3] = {qRed(pixel), qGreen(pixel), qBlue(pixel)};
+        int outputs[3];
+        for(int channel = 0; channel < 3; ++channel) {
+          const int maxLevel = (1 << bits[channel]) - 1;
+          const int idx = ((x + 1) * 3) + channel;
+          const int value = qBound(0, levels.at(inputs[channel]) + (current[idx] / 16), 65535);
+          const int level = (int)((((qint64)value * maxLevel) + 32767) / 65535);
+          outputs[channel] = expand(level, bits[channel]);
+          const int error = value - (int)(((qint64)level * 65535) / maxLevel);
+          current[idx + 3] += error * 7;
+          next[idx - 3] += error * 3;
+          next[idx] += error * 5;
+          next[idx + 3] += error;
+        }
+        dst[x] = qRgb(outputs[0], outputs[1], outputs[2]);
+      }
+    }
+  } else {
+    // Ordered dithering looks up the table of each pixel's position in the
+    // matrix, otherwise all positions share one table
+    const bool isOrdered = dither == CaptureConfig::OrderedDither;
+    const QVector<uchar> *tables = isOrdered?ordered:quantized;
+#ifdef POSTPROCESS_AVX2
+    const bool useAvx2 = (instructionSet == Avx2 || instructionSet == Auto) && isSupported(Avx2);
+#endif
+    int offsets[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for(int y = 0; y < input.height(); ++y) {
+      const QRgb *src = (const QRgb *)input.constScanLine(y);
+      QRgb *dst = (QRgb *)destination.scanLine(y);
+      if(isOrdered) {
+        for(int position = 0; position < 8; ++position) {
+          offsets[position] = (((y & 7) * 8) + position) * 256;
+        }
+      }
+#ifdef POSTPROCESS_AVX2
+      if(useAvx2) {
+        lookupRowAvx2(src, dst, width, tables[0].constData(), tables[1].constData(), tables[2].constData(), offsets);
+        continue;
+      }
+#endif
+      lookupRowScalar(src, dst, width, tables[0].constData(), tables[1].constData(), tables[2].constData(), offsets);
+    }
+  }
+}
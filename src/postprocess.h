@@ -0,0 +1,80 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            postprocess.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __POSTPROCESS_H__
+#define __POSTPROCESS_H__
+
+#include "captureconfig.h"
+
+#include <QImage>
+#include <QVector>
+
+// Panel correction applied to frames on their way out to a panel, an export
+// or the grabbed preview, never to the recorded frames themselves. Gamma and
+// brightness come from a lookup table with 16 bit output, which is then
+// reduced to the panel's bits per channel with optional ordered or
+// Floyd-Steinberg dithering. Ordered dithering is folded into one table per
+// matrix position, so it costs no more than a plain lookup. The lookups use
+// AVX2 gathers when the CPU has them. SSE2 has no gather, so without AVX2 the
+// scalar lookup is used
+class PostProcess
+{
+public:
+  enum InstructionSet {
+    Auto,
+    Scalar,
+    Avx2
+  };
+  PostProcess();
+  ~PostProcess();
+  // Only rebuilds the tables when the settings changed
+  void configure(const CaptureConfig &config);
+  bool isIdentity() const;
+  static bool isSupported(const InstructionSet &instructionSet);
+  // The destination is reused when it already has the right size and format
+  // and nothing else refers to it. Source and destination may be the same.
+  // Floyd-Steinberg dithering is always scalar
+  void apply(const QImage &source, QImage &destination, const InstructionSet &instructionSet = Auto) const;
+
+private:
+  void build();
+  int gamma = 10;
+  int brightness = 100;
+  int bits[3] = {8, 8, 8};
+  CaptureConfig::Dither dither = CaptureConfig::NoDither;
+  bool identity = true;
+  // Gamma and brightness per input value, scaled to 0 - 65535
+  QVector<quint16> levels;
+  // Rounded to the panel depth and expanded back to 8 bits, per channel. The
+  // tables have three spare bytes at the end, so a 32 bit gather of the last
+  // entry stays inside
+  QVector<uchar> quantized[3];
+  // As above for each of the 64 positions of the ordered dither matrix
+  QVector<uchar> ordered[3];
+
+};
+
+#endif // __POSTPROCESS_H__
@@ -0,0 +1,117 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            previewwidget.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "previewwidget.h"
+#include "framestore.h"
+#include "profiler.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+
+#include <string.h>
+
+PreviewWidget::PreviewWidget(const int &scale, QWidget *parent)
+  : QWidget(parent), scale(scale)
+{
+  // Every pixel is painted in paintEvent, so Qt doesn't need to clear first
+  setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+PreviewWidget::~PreviewWidget()
+{
+}
+
+void PreviewWidget::setFrame(const QImage &frame)
+{
+  if(frame.isNull()) {
+    return;
+  }
+  const int lineBytes = (frame.width() * frame.depth()) / 8;
+  quint64 frameHash = ((quint64)frame.format() << 32) ^ ((quint64)frame.width() << 16) ^ frame.height();
+  for(int y = 0; y < frame.height(); ++y) {
+    frameHash = (frameHash * 0x9e3779b185ebca87ULL) ^ FrameStore::hash(frame.constScanLine(y), lineBytes);
+  }
+  if(frameHash == bufferHash && !buffer.isNull()) {
+    return;
+  }
+  bufferHash = frameHash;
+  if(buffer.size() != frame.size() || buffer.format() != frame.format()) {
+    buffer = QImage(frame.size(), frame.format());
+    buffer.setColorTable(frame.colorTable());
+    updateGeometry();
+  }
+  for(int y = 0; y < frame.height(); ++y) {
+    memcpy(buffer.scanLine(y), frame.constScanLine(y), lineBytes);
+  }
+  update();
+}
+
+void PreviewWidget::setOverlay(const QRect &rect)
+{
+  if(rect != overlay) {
+    overlay = rect;
+    update();
+  }
+}
+
+void PreviewWidget::setRegionOverlays(const QVector<QRect> &rects)
+{
+  if(rects != regionOverlays) {
+    regionOverlays = rects;
+    update();
+  }
+}
+
+QSize PreviewWidget::sizeHint() const
+{
+  return buffer.isNull()?QSize(scale, scale):buffer.size() * scale;
+}
+
+void PreviewWidget::paintEvent(QPaintEvent *event)
+{
+  QPainter painter(this);
+  painter.fillRect(event->rect(), Qt::black);
+  if(buffer.isNull()) {
+    return;
+  }
+  {
+    ProfileScope scope(Profiler::Preview);
+    // Without SmoothPixmapTransform the scaled blit samples nearest neighbour
+    painter.drawImage(QRect(QPoint(0, 0), buffer.size() * scale), buffer);
+  }
+  ProfileScope scope(Profiler::Overlay);
+  painter.setBrush(Qt::NoBrush);
+  painter.setPen(QPen(QColor(255, 200, 0), 1));
+  for(const auto &rect: regionOverlays) {
+    painter.drawRect(QRectF(rect.x() * scale - 0.5, rect.y() * scale - 0.5,
+                            rect.width() * scale + 1.0, rect.height() * scale + 1.0));
+  }
+  if(!overlay.isEmpty()) {
+    painter.setPen(QPen(QColor(0, 255, 0), 2));
+    painter.drawRect(QRectF(overlay.x() * scale - 1.0, overlay.y() * scale - 1.0,
+                            overlay.width() * scale + 2.0, overlay.height() * scale + 2.0));
+  }
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            previewwidget.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __PREVIEWWIDGET_H__
+#define __PREVIEWWIDGET_H__
+
+#include <QWidget>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// Shows a frame magnified with nearest neighbour sampling and an optional
+// outline drawn on top. Frames are copied into a buffer that is kept between
+// frames, so a preview never holds on to the capture thread's images, and
+// frames identical to the one shown don't cause a repaint at all
+class PreviewWidget : public QWidget
+{
+  Q_OBJECT
+
+public:
+  PreviewWidget(const int &scale = 4, QWidget *parent = nullptr);
+  ~PreviewWidget();
+  void setFrame(const QImage &frame);
+  // In frame pixels, the outline is drawn just outside of it. An empty
+  // rectangle hides the outline
+  void setOverlay(const QRect &rect);
+  // Thinner outlines of the capture regions, also in frame pixels
+  void setRegionOverlays(const QVector<QRect> &rects);
+  QSize sizeHint() const override;
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+
+private:
+  int scale = 4;
+  QImage buffer;
+  quint64 bufferHash = 0;
+  QRect overlay;
+  QVector<QRect> regionOverlays;
+
+};
+
+#endif // __PREVIEWWIDGET_H__
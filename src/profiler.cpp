@@ -0,0 +1,260 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            profiler.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "profiler.h"
+#include "framequeue.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled{false};
+
+namespace
+{
+  // Per stage durations kept for the percentiles
+  const int recentEvents = 512;
+  // The oldest half of the trace is dropped once it holds this many events
+  const int maximumTrace = 1 << 20;
+
+  struct ThreadBuffer
+  {
+    ThreadBuffer(const int &id)
+      : id(id)
+    {
+    }
+    const int id;
+    FrameQueue<ProfileEvent> events{16384};
+    // Set when the thread exits. The collector then drains and frees it
+    std::atomic<bool> retired{false};
+  };
+
+  // Registers the buffer of a thread and retires it when the thread exits,
+  // so pooled threads that come and go don't keep their buffers around
+  struct BufferOwner
+  {
+    ~BufferOwner()
+    {
+      if(buffer != nullptr) {
+        buffer->retired.store(true, std::memory_order_release);
+        buffer = nullptr;
+      }
+    }
+    ThreadBuffer *buffer = nullptr;
+  };
+
+  QMutex buffersMutex;
+  std::vector<ThreadBuffer *> buffers;
+  // Indexed by thread id, names outlive the buffers for the trace
+  QVector<QString> threadNames;
+  // Dropped events of buffers that have been freed
+  int retiredDropped = 0;
+  thread_local BufferOwner owner;
+
+  // Only touched by the collecting thread
+  QVector<ProfileEvent> trace;
+  QVector<qint64> recent[Profiler::StageCount];
+  int recentPos[Profiler::StageCount] = {};
+  qint64 lastCollect = 0;
+  double ticksPerSecond = 0.0;
+
+  QElapsedTimer startedClock()
+  {
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+  }
+
+  QString escaped(const QString &text)
+  {
+    QString result = text;
+    return result.replace("\\", "\\\\").replace("\"", "\\\"");
+  }
+}
+
+void Profiler::setEnabled(const bool &enabled)
+{
+  if(enabled && !Profiler::enabled) {
+    collect();
+    trace.clear();
+    for(int stage = 0; stage < StageCount; ++stage) {
+      recent[stage].clear();
+      recentPos[stage] = 0;
+    }
+    ticksPerSecond = 0.0;
+  }
+  Profiler::enabled = enabled;
+}
+
+qint64 Profiler::now()
+{
+  static const QElapsedTimer clock = startedClock();
+  return clock.nsecsElapsed();
+}
+
+void Profiler::record(const Stage &stage, const qint64 &start, const qint64 &end)
+{
+  if(owner.buffer == nullptr) {
+    QThread *thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if(QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread()) {
+      name = "main";
+    } else if(name.isEmpty()) {
+      name = "thread";
+    }
+    QMutexLocker locker(&buffersMutex);
+    owner.buffer = new ThreadBuffer(threadNames.count());
+    threadNames.append(name);
+    buffers.push_back(owner.buffer);
+  }
+  ProfileEvent event;
+  event.stage = stage;
+  event.thread = owner.buffer->id;
+  event.start = start;
+  event.end = end;
+  owner.buffer->events.push(std::move(event));
+}
+
+const char *Profiler::stageName(const Stage &stage)
+{
+  static const char *names[StageCount] = {
+    "tick", "grab", "scale", "back buffer", "motion", "crop", "stream",
+    "append", "preview", "overlay", "encode"
+  };
+  return names[stage];
+}
+
+void Profiler::collect()
+{
+  int ticks = 0;
+  {
+    QMutexLocker locker(&buffersMutex);
+    ProfileEvent event;
+    for(auto it = buffers.begin(); it != buffers.end();) {
+      ThreadBuffer *buffer = *it;
+      // Checked before draining, so everything a retired thread recorded has
+      // been drained when its buffer is freed
+      const bool retired = buffer->retired.load(std::memory_order_acquire);
+      while(buffer->events.pop(event)) {
+        if(trace.count() >= maximumTrace) {
+          trace.remove(0, maximumTrace / 2);
+        }
+        trace.append(event);
+        QVector<qint64> &durations = recent[event.stage];
+        if(durations.count() < recentEvents) {
+          durations.append(event.end - event.start);
+        } else {
+          durations[recentPos[event.stage]] = event.end - event.start;
+          recentPos[event.stage] = (recentPos[event.stage] + 1) % recentEvents;
+        }
+        ticks += event.stage == Tick;
+      }
+      if(retired) {
+        retiredDropped += buffer->events.dropped();
+        delete buffer;
+        it = buffers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  const qint64 current = now();
+  if(lastCollect > 0 && current > lastCollect) {
+    ticksPerSecond = ticks / ((current - lastCollect) / 1000000000.0);
+  }
+  lastCollect = current;
+}
+
+Profiler::StageStats Profiler::stats(const Stage &stage)
+{
+  StageStats result;
+  QVector<qint64> durations = recent[stage];
+  result.count = durations.count();
+  if(durations.isEmpty()) {
+    return result;
+  }
+  const int median = durations.count() / 2;
+  std::nth_element(durations.begin(), durations.begin() + median, durations.end());
+  result.p50 = durations.at(median) / 1000000.0;
+  const int tail = (durations.count() * 99) / 100;
+  std::nth_element(durations.begin(), durations.begin() + tail, durations.end());
+  result.p99 = durations.at(tail) / 1000000.0;
+  return result;
+}
+
+double Profiler::tickRate()
+{
+  return ticksPerSecond;
+}
+
+int Profiler::droppedEvents()
+{
+  QMutexLocker locker(&buffersMutex);
+  int dropped = retiredDropped;
+  for(const auto *buffer: buffers) {
+    dropped += buffer->events.dropped();
+  }
+  return dropped;
+}
+
+bool Profiler::saveTrace(const QString &fileName)
+{
+  collect();
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+  QTextStream stream(&file);
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  {
+    QMutexLocker locker(&buffersMutex);
+    for(int id = 0; id < threadNames.count(); ++id) {
+      stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id
+             << ",\"args\":{\"name\":\"" << escaped(threadNames.at(id)) << "\"}}"
+             << (id + 1 < threadNames.count() || !trace.isEmpty()?",\n":"\n");
+    }
+  }
+  // Complete events with microsecond timestamps
+  stream.setRealNumberNotation(QTextStream::FixedNotation);
+  stream.setRealNumberPrecision(3);
+  for(int idx = 0; idx < trace.count(); ++idx) {
+    const ProfileEvent &event = trace.at(idx);
+    stream << "{\"name\":\"" << stageName((Stage)event.stage) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+           << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}"
+           << (idx + 1 < trace.count()?",\n":"\n");
+  }
+  stream << "]}\n";
+  stream.flush();
+  return stream.status() == QTextStream::Ok && file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            profiler.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+struct ProfileEvent
+{
+  int stage = 0;
+  int thread = 0;
+  // Nanoseconds on the profiler clock
+  qint64 start = 0;
+  qint64 end = 0;
+};
+
+// Timings of the hot path stages. Every thread records into a queue of its
+// own without locking, and one thread, normally the GUI thread, collects
+// them into percentiles per stage and a trace that can be saved in the
+// Chrome trace event format. While disabled a scope costs one relaxed load
+class Profiler
+{
+public:
+  enum Stage {
+    Tick,
+    Grab,
+    Scale,
+    BackBuffer,
+    Motion,
+    Crop,
+    Stream,
+    Append,
+    Preview,
+    Overlay,
+    Encode,
+    StageCount
+  };
+  struct StageStats
+  {
+    int count = 0;
+    // Milliseconds over the latest events of the stage
+    double p50 = 0.0;
+    double p99 = 0.0;
+  };
+  // Enabling starts a new trace. Call from the collecting thread
+  static void setEnabled(const bool &enabled);
+  static bool isEnabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+  static qint64 now();
+  static void record(const Stage &stage, const qint64 &start, const qint64 &end);
+  static const char *stageName(const Stage &stage);
+  // Moves the recorded events of all threads into the trace
+  static void collect();
+  static StageStats stats(const Stage &stage);
+  // Capture ticks per second between the last two collections
+  static double tickRate();
+  // Events lost because a thread recorded faster than they were collected
+  static int droppedEvents();
+  static bool saveTrace(const QString &fileName);
+
+private:
+  static std::atomic<bool> enabled;
+
+};
+
+// Times the enclosing block as one event of the stage
+class ProfileScope
+{
+public:
+  explicit ProfileScope(const Profiler::Stage &stage)
+    : stage(stage), start(Profiler::isEnabled()?Profiler::now():-1)
+  {
+  }
+  ~ProfileScope()
+  {
+    if(start >= 0) {
+      Profiler::record(stage, start, Profiler::now());
+    }
+  }
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  const Profiler::Stage stage;
+  const qint64 start;
+
+};
+
+#endif // __PROFILER_H__
@@ -51,6 +51,12 @@ Slider::Slider(QSettings &settings, const QString &key, const QString &title, co
   sliderLineEdit->setMaximumWidth(50);
   connect(sliderLineEdit, &QLineEdit::textEdited, this, &Slider::textEdited);
 
+  // Dragging a slider emits a value for every step. Only write the final
+  // value to the config file once the slider has been left alone for a moment
+  saveTimer.setSingleShot(true);
+  saveTimer.setInterval(500);
+  connect(&saveTimer, &QTimer::timeout, this, &Slider::saveValue);
+
   QValidator *intValidator = new QIntValidator(1, maxValue, this);
   sliderLineEdit->setValidator(intValidator);
   
@@ -64,13 +70,16 @@ Slider::Slider(QSettings &settings, const QString &key, const QString &title, co
 
 Slider::~Slider()
 {
+  if(saveTimer.isActive()) {
+    saveValue();
+  }
 }
 
 void Slider::sliderMoved(int val)
 {
   sliderLineEdit->setText(QString::number(val));
   if(preserve) {
-    settings.setValue(key, val);
+    saveTimer.start();
   }
   emit valueChanged(val);
 }
@@ -79,12 +88,17 @@ void Slider::textEdited(const QString &text)
 {
   slider->setValue(text.toInt());
   if(preserve) {
-    settings.setValue(key, text.toInt());
+    saveTimer.start();
   }
 
   emit valueChanged(text.toInt());
 }
 
+void Slider::saveValue()
+{
+  settings.setValue(key, slider->value());
+}
+
 int Slider::getValue()
 {
   return slider->value();
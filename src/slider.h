@@ -31,6 +31,7 @@
 #include <QSettings>
 #include <QSlider>
 #include <QLineEdit>
+#include <QTimer>
 
 class Slider : public QWidget
 {
@@ -49,6 +50,7 @@ signals:
 private slots:
   void sliderMoved(int val);
   void textEdited(const QString &text);
+  void saveValue();
   
 private:
   QSettings &settings;
@@ -56,6 +58,7 @@ private:
   bool preserve = true;
   QSlider *slider = nullptr;
   QLineEdit *sliderLineEdit = nullptr;
+  QTimer saveTimer;
   
 };
 
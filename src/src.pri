@@ -0,0 +1,64 @@
+# Everything but main(), shared by the application and the tests
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+QT += widgets concurrent network
+
+include($$PWD/../VERSION)
+DEFINES+=VERSION=\\\"$$VERSION\\\"
+
+# Input
+HEADERS += $$PWD/window.h \
+           $$PWD/captureworker.h \
+           $$PWD/capturepipeline.h \
+           $$PWD/framequeue.h \
+           $$PWD/backbuffer.h \
+           $$PWD/captureconfig.h \
+           $$PWD/exporter.h \
+           $$PWD/framestore.h \
+           $$PWD/pixelconvert.h \
+           $$PWD/ledanimation.h \
+           $$PWD/animatedexport.h \
+           $$PWD/ledstreamer.h \
+           $$PWD/headlesscapture.h \
+           $$PWD/capturesource.h \
+           $$PWD/downscale.h \
+           $$PWD/previewwidget.h \
+           $$PWD/motionestimator.h \
+           $$PWD/framejournal.h \
+           $$PWD/postprocess.h \
+           $$PWD/griddetector.h \
+           $$PWD/profiler.h \
+           $$PWD/cursortracker.h \
+           $$PWD/slider.h
+
+SOURCES += $$PWD/window.cpp \
+           $$PWD/captureworker.cpp \
+           $$PWD/capturepipeline.cpp \
+           $$PWD/backbuffer.cpp \
+           $$PWD/captureconfig.cpp \
+           $$PWD/exporter.cpp \
+           $$PWD/framestore.cpp \
+           $$PWD/pixelconvert.cpp \
+           $$PWD/ledanimation.cpp \
+           $$PWD/animatedexport.cpp \
+           $$PWD/ledstreamer.cpp \
+           $$PWD/headlesscapture.cpp \
+           $$PWD/capturesource.cpp \
+           $$PWD/downscale.cpp \
+           $$PWD/previewwidget.cpp \
+           $$PWD/motionestimator.cpp \
+           $$PWD/framejournal.cpp \
+           $$PWD/postprocess.cpp \
+           $$PWD/griddetector.cpp \
+           $$PWD/profiler.cpp \
+           $$PWD/cursortracker.cpp \
+           $$PWD/slider.cpp
+
+# Zero-copy X11 capture through MIT-SHM when the xcb libraries are available
+unix:!macx:packagesExist(xcb xcb-shm) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += xcb xcb-shm
+  DEFINES += RETROGRAB_XSHM
+  HEADERS += $$PWD/xshmcapturesource.h
+  SOURCES += $$PWD/xshmcapturesource.cpp
+}
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = RetroGrab
+# At the top of the build directory, where config.ini is looked for
+DESTDIR = $$OUT_PWD/..
+CONFIG += release
+
+include(src.pri)
+
+SOURCES += main.cpp
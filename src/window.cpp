@@ -30,10 +30,56 @@
 #include <QtWidgets>
 #include <QSettings>
 #include <QMessageBox>
+#include <QtConcurrent>
 
 Window::Window(QSettings &settings)
   : settings(settings)
 {
+  CaptureConfig config;
+  config.load(settings);
+  frames.setPixelFormat(FrameStore::pixelFormatFromName(settings.value("grab/pixelFormat", "rgb888").toString()));
+  frames.setDeduplicate(settings.value("grab/dedup", true).toBool());
+  for(int idx = 0; idx < config.regions.count(); ++idx) {
+    regionFrames.append(new FrameStore(frames.pixelFormat()));
+    regionFrames.last()->setDeduplicate(settings.value("grab/dedup", true).toBool());
+  }
+  if(settings.value("journal/enabled", true).toBool()) {
+    const QString journalPath = settings.value("journal/path", "./journal").toString();
+    const QString journalFile = journalPath + "/session.rgj";
+    // The budget is shared by the main store and the region stores
+    const qint64 memoryBudget = (settings.value("journal/memoryBudget", 256).toLongLong() * 1024 * 1024) /
+                                (regionFrames.count() + 1);
+    QDir().mkpath(journalPath);
+    // A journal holding more than its header means the last session ended
+    // without clearing its frames, possibly by crashing
+    bool reopened = false;
+    if(QFileInfo(journalFile).size() > 32 &&
+       QMessageBox::question(this, tr("Reopen last session?"),
+                             tr("Frames from the last session were found. Do you want to continue with them?"),
+                             QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
+      // Regions are only reopened along with the main session, and a region
+      // that can't be reopened fails the whole session, so all stores stay
+      // on the same timeline
+      reopened = frames.reopenJournal(journalFile, memoryBudget);
+      for(int idx = 0; reopened && idx < regionFrames.count(); ++idx) {
+        const QString regionFile = journalPath + "/session-" + config.regions.at(idx).name + ".rgj";
+        reopened = regionFrames.at(idx)->reopenJournal(regionFile, memoryBudget);
+      }
+      if(!reopened) {
+        QMessageBox::warning(this, tr("Reopen failed"), tr("The frames of the last session could not be read. They have been kept in '%1'.").arg(journalFile + ".bak"));
+      }
+    }
+    // Starting over keeps any journals of the last session as '.bak'
+    if(!reopened) {
+      frames.setJournal(journalFile, memoryBudget);
+      for(int idx = 0; idx < regionFrames.count(); ++idx) {
+        regionFrames.at(idx)->setJournal(journalPath + "/session-" + config.regions.at(idx).name + ".rgj", memoryBudget);
+      }
+    }
+  }
+  configStore.edit() = config;
+  configStore.publish();
+
   setWindowTitle("RetroGrab v" VERSION);
   setMinimumWidth(1300);
   setMinimumHeight(600);
@@ -41,12 +87,20 @@ Window::Window(QSettings &settings)
     restoreGeometry(settings.value("main/windowState", "").toByteArray());
   }
 
-  viewport = new QLabel();
-  viewport->setStyleSheet("background-color: #000000;");
-
-  grabbed = new QLabel();
-  grabbed->setStyleSheet("background-color: #000000;");
+  viewport = new PreviewWidget();
+  grabbed = new PreviewWidget();
   frameStatusLabel = new QLabel(QString::number(frameIdx) + " / " + QString::number(frames.count()));
+  // Stage timings, collected twice per second while profiling is enabled
+  profileLabel = new QLabel();
+  profileLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  profileTimer.setInterval(500);
+  connect(&profileTimer, &QTimer::timeout, this, &Window::updateProfile);
+  if(settings.value("debug/profile", false).toBool()) {
+    Profiler::setEnabled(true);
+    profileTimer.start();
+  } else {
+    profileLabel->hide();
+  }
 
   recordButton = new QPushButton("Start Recording");
   connect(recordButton, &QPushButton::clicked, this, &Window::initRecording);
@@ -54,42 +108,96 @@ Window::Window(QSettings &settings)
   connect(clearButton, &QPushButton::clicked, this, &Window::clearFrames);
   QPushButton *exportButton = new QPushButton("Export");
   connect(exportButton, &QPushButton::clicked, this, &Window::exportFrames);
+  QPushButton *exportAnimationButton = new QPushButton("Export LED animation...");
+  connect(exportAnimationButton, &QPushButton::clicked, this, &Window::exportAnimation);
+  QPushButton *openAnimationButton = new QPushButton("Open LED animation...");
+  connect(openAnimationButton, &QPushButton::clicked, this, &Window::openAnimation);
+  QPushButton *detectGridButton = new QPushButton("Detect grid");
+  connect(detectGridButton, &QPushButton::clicked, this, &Window::detectGrid);
+
+  // With streaming export enabled, recorded frames are encoded in the
+  // background so the final export only has to move them into place
+  exporter = new Exporter(this);
+  connect(&animationWatcher, &QFutureWatcher<void>::finished, this, &Window::animationFinished);
+  if(settings.value("export/streaming", false).toBool()) {
+    exporter->setStagingPath(settings.value("export/path", "./export").toString() + "/.stream");
+    exporter->clearStaging();
+  }
+
+  cursorTracker = new CursorTracker(configStore, this);
+  worker = new CaptureWorker(configStore, *cursorTracker);
+  worker->moveToThread(&captureThread);
+  captureThread.setObjectName("capture");
+  connect(&captureThread, &QThread::finished, worker, &QObject::deleteLater);
+  connect(worker, &CaptureWorker::framesAvailable, this, &Window::consumeFrames);
 
   Slider *viewportWidthSlider = new Slider(settings, "viewport/width", "Viewport width:", 256, 128);
   Slider *viewportHeightSlider = new Slider(settings, "viewport/height", "Viewport height:", 256, 128);
 
-  Slider *viewportDividerSlider = new Slider(settings, "viewport/divider", "Viewport scale:", 32, 1);
+  viewportDividerSlider = new Slider(settings, "viewport/divider", "Viewport scale:", 32, 1);
 
-  Slider *snapAlignmentXSlider = new Slider(settings, "viewport/snapAlignmentX", "Snap alignment X:", 16, 1);
-  Slider *snapAlignmentYSlider = new Slider(settings, "viewport/snapAlignmentY", "Snap alignment Y:", 16, 1);
+  snapAlignmentXSlider = new Slider(settings, "viewport/snapAlignmentX", "Snap alignment X:", 32, 1);
+  snapAlignmentYSlider = new Slider(settings, "viewport/snapAlignmentY", "Snap alignment Y:", 32, 1);
 
   Slider *grabWidthSlider = new Slider(settings, "grab/width", "Grab width:", 64, 16);
   Slider *grabHeightSlider = new Slider(settings, "grab/height", "Grab width:", 64, 16);
 
   Slider *fpsSlider = new Slider(settings, "viewport/fps", "FPS (frames per second):", 60, 30);
-  connect(fpsSlider, &Slider::valueChanged, this, &Window::setFps);
 
   Slider *backBufferSlider = new Slider(settings, "grab/backBuffer", "Grab look-ahead (number of frames):", 20, 5);
 
+  bindSlider(viewportWidthSlider, &CaptureConfig::viewportWidth);
+  bindSlider(viewportHeightSlider, &CaptureConfig::viewportHeight);
+  bindSlider(viewportDividerSlider, &CaptureConfig::divider);
+  bindSlider(snapAlignmentXSlider, &CaptureConfig::snapAlignmentX);
+  bindSlider(snapAlignmentYSlider, &CaptureConfig::snapAlignmentY);
+  bindSlider(grabWidthSlider, &CaptureConfig::grabWidth);
+  bindSlider(grabHeightSlider, &CaptureConfig::grabHeight);
+  bindSlider(fpsSlider, &CaptureConfig::fps);
+  bindSlider(backBufferSlider, &CaptureConfig::backBuffer);
+  Slider *gammaSlider = new Slider(settings, "post/gamma", "Panel gamma (tenths):", 40, 10);
+  bindSlider(gammaSlider, &CaptureConfig::gamma);
+  Slider *brightnessSlider = new Slider(settings, "post/brightness", "Panel brightness (percent):", 100, 100);
+  bindSlider(brightnessSlider, &CaptureConfig::brightness);
+
   Slider *recordDelaySlider = new Slider(settings, "grab/delay", "Recording delay:", 20, 5);
 
   QHBoxLayout *labelLayout = new QHBoxLayout();
-  mouseSnapLabel = new QLabel("Mouse pixel snap (ctrl+alt+s): " + QString(mouseSnap?"true":"false"));
-  lockXLabel = new QLabel("Mouse X locked (ctrl+alt+x): " + QString(lockX?"true":"false"));
-  lockYLabel = new QLabel("Mouse Y locked (ctrl+alt+y): " + QString(lockY?"true":"false"));
+  mouseSnapLabel = new QLabel("Mouse pixel snap (ctrl+alt+s): " + QString(config.mouseSnap?"true":"false"));
+  lockXLabel = new QLabel("Mouse X locked (ctrl+alt+x): " + QString(config.lockX?"true":"false"));
+  lockYLabel = new QLabel("Mouse Y locked (ctrl+alt+y): " + QString(config.lockY?"true":"false"));
   labelLayout->addWidget(mouseSnapLabel);
   labelLayout->addWidget(lockXLabel);
   labelLayout->addWidget(lockYLabel);
+  roiLabel = new QLabel("ROI recording (ctrl+alt+r): " + QString(config.roiCapture?"true":"false"));
+  labelLayout->addWidget(roiLabel);
+  adaptiveLabel = new QLabel("Adaptive capture (ctrl+alt+a): " + QString(config.adaptiveCapture?"true":"false"));
+  labelLayout->addWidget(adaptiveLabel);
+  motionLabel = new QLabel();
+  labelLayout->addWidget(motionLabel);
+  updateMotionLabel();
+  streamLabel = new QLabel("LED streaming (ctrl+alt+l): " + QString(config.streamEnabled?"true":"false"));
+  labelLayout->addWidget(streamLabel);
+  ditherLabel = new QLabel();
+  updateDitherLabel();
+  labelLayout->addWidget(ditherLabel);
+  gridLabel = new QLabel();
+  updateGridLabel();
+  labelLayout->addWidget(gridLabel);
 
   QHBoxLayout *buttonLayout = new QHBoxLayout();
   buttonLayout->addWidget(recordButton);
   buttonLayout->addWidget(clearButton);
   buttonLayout->addWidget(exportButton);
+  buttonLayout->addWidget(exportAnimationButton);
+  buttonLayout->addWidget(openAnimationButton);
+  buttonLayout->addWidget(detectGridButton);
 
   QVBoxLayout *leftLayout = new QVBoxLayout();
   leftLayout->addWidget(viewport, 0, Qt::AlignTop | Qt::AlignCenter);
   leftLayout->addWidget(grabbed, 0, Qt::AlignTop | Qt::AlignCenter);
   leftLayout->addWidget(frameStatusLabel, 0, Qt::AlignTop | Qt::AlignCenter);
+  leftLayout->addWidget(profileLabel, 0, Qt::AlignTop | Qt::AlignCenter);
   leftLayout->addStretch(500);
   
   QVBoxLayout *rightLayout = new QVBoxLayout();
@@ -103,6 +211,8 @@ Window::Window(QSettings &settings)
   rightLayout->addWidget(grabWidthSlider);
   rightLayout->addWidget(grabHeightSlider);
   rightLayout->addWidget(recordDelaySlider);
+  rightLayout->addWidget(gammaSlider);
+  rightLayout->addWidget(brightnessSlider);
   rightLayout->addLayout(labelLayout);
   rightLayout->addLayout(buttonLayout);
 
@@ -116,75 +226,201 @@ Window::Window(QSettings &settings)
   
   setLayout(layout);
   show();
-  grabTimer.start(1000 / settings.value("viewport/fps", 30).toInt(), Qt::PreciseTimer, this);
+
+  captureThread.start();
+  QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection);
 }
 
 Window::~Window()
 {
   settings.setValue("main/windowState", saveGeometry());
+  QMetaObject::invokeMethod(worker, "stop", Qt::BlockingQueuedConnection);
+  captureThread.quit();
+  captureThread.wait();
+  animationWatcher.cancel();
+  animationWatcher.waitForFinished();
+  qDeleteAll(regionFrames);
 }
 
-void Window::timerEvent(QTimerEvent *)
+void Window::consumeFrames()
 {
-  QPoint pos = QCursor::pos();
-  if(lockX) {
-    pos.setX(lockPosX);
-  }
-  if(lockY) {
-    pos.setY(lockPosY);
-  }
-  int viewportWidth = settings.value("viewport/width", 128).toInt();
-  int viewportHeight = settings.value("viewport/height", 128).toInt();
-  int grabWidth = settings.value("grab/width", 16).toInt();
-  int grabHeight = settings.value("grab/height", 16).toInt();
-  double scaleDivider = settings.value("viewport/divider", 1.0).toDouble();
-  int snapAlignmentX = settings.value("viewport/snapAlignmentX", 1).toInt();
-  int snapAlignmentY = settings.value("viewport/snapAlignmentY", 1).toInt();
-  
-  QPixmap viewportGrab = QGuiApplication::screenAt(QPoint(0, 0))->grabWindow(0,
-                                                                             snapAlignmentX + (pos.x() - (mouseSnap?pos.x() % (int)scaleDivider:0)) - ((viewportWidth * scaleDivider) / 2.0),
-                                                                             snapAlignmentY + (pos.y() - (mouseSnap?pos.y() % (int)scaleDivider:0)) - ((viewportHeight * scaleDivider) / 2.0),
-                                                                             viewportWidth * scaleDivider,
-                                                                             viewportHeight * scaleDivider);
-  viewportGrab = viewportGrab.scaledToWidth(viewportWidth);
-  backBufferPixmap.push_back(viewportGrab);
-  backBufferMouse.push_back(pos);
-  int backBufferLength = settings.value("grab/backBuffer", 5).toInt();
-  while(backBufferPixmap.length() > backBufferLength) {
-    backBufferPixmap.pop_front();
-    backBufferMouse.pop_front();
-  }
-  QPainter painter(&viewportGrab);
-  painter.setPen(QColor(0, 255, 0));
-  painter.drawRect((viewportWidth / 2) - (grabWidth / 2) - 1, (viewportHeight / 2) - (grabHeight / 2) - 1, grabWidth + 1, grabHeight + 1);
-  painter.end();
-  
-  viewport->setPixmap(viewportGrab.scaledToHeight(viewportGrab.height() * 4));
-
-  if((recording || shiftRecording) &&
-     backBufferPixmap.length() >= backBufferLength) {
-    QPixmap grab = backBufferPixmap.first().copy(((viewportWidth / 2) - (grabWidth / 2)) + ((pos.x() - backBufferMouse.first().x()) / scaleDivider),
-                                                 ((viewportHeight / 2) - (grabHeight / 2)) + ((pos.y() - backBufferMouse.first().y()) / scaleDivider),
-                                                 grabWidth,
-                                                 grabHeight);
-    if(grab.width() == grabWidth &&
-       grab.height() == grabHeight) {
-      frames.append(grab);
+  worker->acknowledgeFrames();
+
+  CapturedFrame captured;
+  bool hasPreview = false;
+  while(worker->previewQueue.pop(captured)) {
+    hasPreview = true;
+  }
+  if(hasPreview) {
+    int grabWidth = configStore.current().grabWidth;
+    int grabHeight = configStore.current().grabHeight;
+    const QRect grabRect((captured.image.width() / 2) - (grabWidth / 2), (captured.image.height() / 2) - (grabHeight / 2), grabWidth, grabHeight);
+    viewport->setFrame(captured.image);
+    viewport->setOverlay(grabRect);
+    // Regions fixed to the desktop move around in the viewport and aren't shown
+    QVector<QRect> regionRects;
+    for(const auto &region: configStore.current().regions) {
+      if(!region.fixed) {
+        regionRects.append(QRect(grabRect.topLeft() + region.offset, region.size));
+      }
     }
+    viewport->setRegionOverlays(regionRects);
+    // Let go of the slot image so the capture thread can reuse it
+    captured = CapturedFrame();
+    updateMotionLabel();
+  }
+
+  PixelGrid grid;
+  while(worker->gridQueue.pop(grid)) {
+    applyGrid(grid);
   }
 
+  while(worker->recordQueue.pop(captured)) {
+    ProfileScope scope(Profiler::Append);
+    if(frames.append(captured.image, captured.timestamp) == FrameStore::Appended) {
+      exporter->stageFrame(frames.count() - 1, frames.frame(frames.count() - 1));
+    }
+    for(int idx = 0; idx < regionFrames.count(); ++idx) {
+      regionFrames.at(idx)->append(captured.regions.value(idx), captured.timestamp);
+    }
+  }
+
+  // Play back the grabbed frames, showing each one for as many ticks as it
+  // was held for
   if(!frames.isEmpty()) {
-    if(frameIdx > frames.count()) {
+    if(frameIdx >= frames.count()) {
       frameIdx = 0;
+      holdTick = 0;
+    }
+    if(holdTick == 0) {
+      // Shown the way the panel will show it
+      postProcess.configure(configStore.current());
+      if(postProcess.isIdentity()) {
+        grabbed->setFrame(frames.frame(frameIdx));
+      } else {
+        postProcess.apply(frames.frame(frameIdx), correctedFrame);
+        grabbed->setFrame(correctedFrame);
+      }
+      updateFrameStatus();
+    }
+    holdTick++;
+    if(holdTick >= frames.hold(frameIdx)) {
+      holdTick = 0;
+      frameIdx++;
     }
-    if(frameIdx < frames.count()) {
-      grabbed->setPixmap(frames.at(frameIdx).scaledToHeight(frames.at(frameIdx).height() * 4));
-      frameStatusLabel->setText(QString::number(frameIdx) + " / " + QString::number(frames.count()));
+  }
+}
+
+void Window::bindSlider(Slider *slider, int CaptureConfig::*member)
+{
+  connect(slider, &Slider::valueChanged, this, [this, member](int value) {
+    configStore.edit().*member = value;
+    configStore.publish();
+  });
+}
+
+void Window::updateFrameStatus()
+{
+  QString status = QString::number(frameIdx) + " / " + QString::number(frames.count());
+  // Dropped preview frames are harmless, only report recorded frames that were lost
+  int dropped = worker->recordQueue.dropped();
+  if(dropped > 0) {
+    status.append(" (dropped: " + QString::number(dropped) + ")");
+  }
+  if(frames.journalFailed()) {
+    status.append(" (journal failed)");
+  }
+  int skipped = worker->skippedTicks();
+  if(skipped > 0) {
+    status.append(" (skipped ticks: " + QString::number(skipped) + ")");
+  }
+  frameStatusLabel->setText(status);
+}
+
+void Window::updateProfile()
+{
+  Profiler::collect();
+  QString text = QString("%1 ticks/s, %2 skipped, %3 dropped, %4 MiB in memory")
+    .arg(Profiler::tickRate(), 0, 'f', 1)
+    .arg(worker->skippedTicks())
+    .arg(worker->recordQueue.dropped())
+    .arg(frames.memoryUsage() / (1024.0 * 1024.0), 0, 'f', 1);
+  if(Profiler::droppedEvents() > 0) {
+    text.append(QString(", %1 events lost").arg(Profiler::droppedEvents()));
+  }
+  text.append(QString("\n%1 %2 %3").arg("stage", -12).arg("p50 ms", 8).arg("p99 ms", 8));
+  for(int stage = 0; stage < Profiler::StageCount; ++stage) {
+    const Profiler::StageStats stats = Profiler::stats((Profiler::Stage)stage);
+    if(stats.count > 0) {
+      text.append(QString("\n%1 %2 %3").arg(Profiler::stageName((Profiler::Stage)stage), -12)
+                  .arg(stats.p50, 8, 'f', 3).arg(stats.p99, 8, 'f', 3));
     }
-    frameIdx++;
+  }
+  profileLabel->setText(text);
+}
+
+void Window::updateDitherLabel()
+{
+  const CaptureConfig::Dither dither = configStore.current().dither;
+  ditherLabel->setText("Panel dithering (ctrl+alt+d): " + QString(dither == CaptureConfig::OrderedDither?"ordered":
+                                                                 dither == CaptureConfig::FloydSteinberg?"floyd-steinberg":"none") +
+                       " at " + configStore.current().colorDepth);
+}
+
+void Window::updateGridLabel()
+{
+  QString text = "Grid detection (ctrl+alt+g): " + QString(configStore.current().gridDetection?"true":"false");
+  if(lastGrid.found) {
+    text.append(QString(" (%1x at %2,%3)").arg(lastGrid.scale).arg(lastGrid.phaseX).arg(lastGrid.phaseY));
+  } else if(hasGridResult) {
+    text.append(" (no grid)");
+  }
+  gridLabel->setText(text);
+}
+
+void Window::detectGrid()
+{
+  gridOneShot = true;
+  worker->detectGrid();
+}
+
+void Window::applyGrid(const PixelGrid &grid)
+{
+  const bool confirmed = gridOneShot ||
+    (grid.scale == lastGrid.scale && grid.phaseX == lastGrid.phaseX && grid.phaseY == lastGrid.phaseY);
+  lastGrid = grid;
+  hasGridResult = true;
+  gridOneShot = false;
+  updateGridLabel();
+  if(!grid.found || !confirmed) {
+    return;
+  }
+  // The sliders publish the new settings themselves. The snap alignment is
+  // the offset that puts the viewport origin on the start of a source pixel,
+  // see CapturePipeline::run()
+  const CaptureConfig &config = configStore.current();
+  if(config.divider != grid.scale) {
+    viewportDividerSlider->setValue(grid.scale);
+  }
+  if(grid.hasPhaseX) {
+    const int snap = (grid.phaseX + (((config.viewportWidth * grid.scale) + 1) / 2)) % grid.scale;
+    snapAlignmentXSlider->setValue(snap == 0?grid.scale:snap);
+  }
+  if(grid.hasPhaseY) {
+    const int snap = (grid.phaseY + (((config.viewportHeight * grid.scale) + 1) / 2)) % grid.scale;
+    snapAlignmentYSlider->setValue(snap == 0?grid.scale:snap);
   }
 }
 
+void Window::updateMotionLabel()
+{
+  QString text = "Motion compensation (ctrl+alt+m): " + QString(configStore.current().motionCompensation?"true":"false");
+  if(configStore.current().motionCompensation) {
+    text.append(QString(" (%1 ms)").arg(worker->motionEstimateNsecs() / 1000000.0, 0, 'f', 2));
+  }
+  motionLabel->setText(text);
+}
+
 void Window::initRecording()
 {
   if(!recording) {
@@ -193,6 +429,7 @@ void Window::initRecording()
     delayTimer.start();
   } else {
     recording = false;
+    worker->setRecording(recording || shiftRecording);
     delayTimer.stop();
     recordButton->setText("Start Recording");
   }
@@ -201,11 +438,15 @@ void Window::initRecording()
 void Window::startRecording()
 {
   recording = true;
+  worker->setRecording(recording || shiftRecording);
   recordButton->setText("Stop recording");
 }
 
 void Window::exportFrames()
 {
+  if(exporter->isRunning()) {
+    return;
+  }
   QDir exportDir(settings.value("export/path", "./export").toString());
   if(!exportDir.exists()) {
     if(!exportDir.mkpath(exportDir.absolutePath())) {
@@ -213,40 +454,150 @@ void Window::exportFrames()
       return;
     }
   }
-  bool overwriteAsk = settings.value("export/overwriteAsk", true).toBool();
-  int idx = 0;
-  for(const auto &frame: frames) {
-    QString zeros = QString::number(idx);
-    while(zeros.length() < 6) {
-      zeros.prepend("0");
+  QString frameName = "frame";
+  // Regions are exported to a subdirectory each
+  QVector<ExportSet> sets({{&frames, exportHolds(), exportDir.absolutePath()}});
+  for(int idx = 0; idx < regionFrames.count(); ++idx) {
+    const QString path = exportDir.absoluteFilePath(configStore.current().regions.at(idx).name);
+    if(!QDir().mkpath(path)) {
+      QMessageBox::information(this, tr("Cancelled"), tr("The export path could not be created. Export has been cancelled."));
+      return;
+    }
+    sets.append({regionFrames.at(idx), regionHolds(idx), path});
+  }
+  bool exists = false;
+  for(const auto &set: sets) {
+    exists = exists || !Exporter::existingFrames(set.path, frameName).isEmpty();
+  }
+  if(exists) {
+    if(settings.value("export/overwriteAsk", true).toBool() &&
+       QMessageBox::question(this, tr("Overwrite?"),
+                             tr("An export already exists. Do you want to overwrite it (the existing one will be removed)?"),
+                             QMessageBox::Yes | QMessageBox::No)
+       != QMessageBox::Yes) {
+      QMessageBox::information(this, tr("Cancelled"), tr("The export has been cancelled."));
+      return;
+    }
+    for(const auto &set: sets) {
+      for(const auto &fileName: Exporter::existingFrames(set.path, frameName)) {
+        QFile::remove(QDir(set.path).absoluteFilePath(fileName));
+      }
     }
-    QString frameName = "frame";
-    QString currentFrame = exportDir.absolutePath() + "/" + frameName + zeros + ".png";
-    if(QFileInfo::exists(currentFrame)) {
-      if(overwriteAsk &&
-         QMessageBox::question(this, tr("Overwrite?"),
-                               tr("An export already exists. Do you want to overwrite it (the existing one will be removed)?"),
-                               QMessageBox::Yes | QMessageBox::No)
-         != QMessageBox::Yes) {
-        QMessageBox::information(this, tr("Cancelled"), tr("The export has been cancelled."));
+  }
+
+  // The range is set by the exporter, it counts jobs over all the sets
+  QProgressDialog *progressDialog = new QProgressDialog(tr("Exporting frames..."), tr("Cancel"), 0, 0, this);
+  progressDialog->setMinimumDuration(500);
+  connect(exporter, &Exporter::progress, progressDialog, [progressDialog](int done, int total) {
+    progressDialog->setMaximum(total);
+    progressDialog->setValue(done);
+  });
+  connect(progressDialog, &QProgressDialog::canceled, exporter, &Exporter::cancel);
+  connect(exporter, &Exporter::finished, progressDialog, &QObject::deleteLater);
+  postProcess.configure(configStore.current());
+  exporter->setPostProcess(postProcess);
+  exporter->start(sets, frameName);
+}
+
+QVector<int> Window::exportHolds()
+{
+  // With export/fps set the recorded timeline is resampled to exactly that
+  // rate, otherwise frames are exported tick by tick as recorded
+  return frames.holdsAt(settings.value("export/fps", 0).toInt(), configStore.current().fps);
+}
+
+QVector<int> Window::regionHolds(const int &idx)
+{
+  return regionFrames.at(idx)->holdsAt(settings.value("export/fps", 0).toInt(), configStore.current().fps);
+}
+
+int Window::exportFps()
+{
+  const int fps = settings.value("export/fps", 0).toInt();
+  return fps > 0?fps:configStore.current().fps;
+}
+
+void Window::exportAnimation()
+{
+  if(frames.isEmpty() || animationWatcher.isRunning()) {
+    return;
+  }
+  QString filter;
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export LED animation"),
+                                                  settings.value("export/path", "./export").toString(),
+                                                  tr("LED animation (*.rgla);;C header (*.h);;Animated GIF (*.gif);;Animated PNG (*.apng *.png)"),
+                                                  &filter);
+  if(fileName.isEmpty()) {
+    return;
+  }
+  // Without a suffix the one of the chosen filter is used
+  if(QFileInfo(fileName).suffix().isEmpty()) {
+    fileName.append(filter.contains("*.h")?".h":filter.contains("*.gif")?".gif":filter.contains("*.apng")?".apng":".rgla");
+  }
+  const QString format = LedAnimation::formatFromFileName(fileName);
+  // Each region goes next to the main animation in a file of its own.
+  // Copying a store only shares its frames, so the snapshots are cheap
+  animationJobs.clear();
+  for(int idx = -1; idx < regionFrames.count(); ++idx) {
+    AnimationJob job;
+    job.frames = idx < 0?frames:*regionFrames.at(idx);
+    job.durations = LedAnimation::durations(idx < 0?exportHolds():regionHolds(idx), exportFps());
+    job.fileName = idx < 0?fileName:Exporter::regionFileName(fileName, configStore.current().regions.at(idx).name);
+    animationJobs.append(job);
+  }
+
+  QProgressDialog *progressDialog = new QProgressDialog(tr("Exporting LED animation..."), tr("Cancel"), 0, animationJobs.count(), this);
+  progressDialog->setMinimumDuration(500);
+  connect(&animationWatcher, &QFutureWatcher<void>::progressValueChanged, progressDialog, &QProgressDialog::setValue);
+  connect(progressDialog, &QProgressDialog::canceled, &animationWatcher, &QFutureWatcher<void>::cancel);
+  connect(&animationWatcher, &QFutureWatcher<void>::finished, progressDialog, &QObject::deleteLater);
+  postProcess.configure(configStore.current());
+  const PostProcess correction = postProcess;
+  animationWatcher.setFuture(QtConcurrent::map(animationJobs, [format, correction](AnimationJob &job) {
+    job.saved = LedAnimation::saveAs(format, job.fileName, job.frames, job.durations, &correction);
+  }));
+}
+
+void Window::animationFinished()
+{
+  // Cancelling skips the stores that haven't been started yet
+  if(!animationWatcher.isCanceled()) {
+    for(const auto &job: animationJobs) {
+      if(!job.saved) {
+        QMessageBox::warning(this, tr("Export failed"), tr("The LED animation could not be written to '%1'.").arg(job.fileName));
         break;
-      } else {
-        for(const auto &fileInfo: exportDir.entryInfoList(QDir::Files)) {
-          if(fileInfo.fileName().left(frameName.length()) == frameName && fileInfo.suffix() == "png") {
-            QFile::remove(fileInfo.absoluteFilePath());
-          }
-        }
       }
     }
-    overwriteAsk = false;
-    frame.save(currentFrame);
-    idx++;
   }
+  animationJobs.clear();
 }
 
-void Window::setFps(int fps)
+void Window::openAnimation()
 {
-  grabTimer.start(1000 / fps, Qt::PreciseTimer, this);
+  if(!frames.isEmpty() &&
+     QMessageBox::question(this, tr("Replace frames?"),
+                           tr("Opening an animation replaces all grabbed frames. Do you want to continue?"),
+                           QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+    return;
+  }
+  QString fileName = QFileDialog::getOpenFileName(this, tr("Open LED animation"),
+                                                  settings.value("export/path", "./export").toString(),
+                                                  tr("LED animation (*.rgla)"));
+  if(fileName.isEmpty()) {
+    return;
+  }
+  exporter->clearStaging();
+  // An animation only holds a single region
+  for(auto *regionStore: regionFrames) {
+    regionStore->clear();
+  }
+  if(!LedAnimation::load(fileName, frames, qRound(1000.0 / configStore.current().fps))) {
+    frames.clear();
+    QMessageBox::warning(this, tr("Open failed"), tr("'%1' is not a valid LED animation.").arg(fileName));
+  }
+  frameIdx = 0;
+  holdTick = 0;
+  updateFrameStatus();
 }
 
 void Window::keyPressEvent(QKeyEvent *event)
@@ -254,28 +605,98 @@ void Window::keyPressEvent(QKeyEvent *event)
   if(event->key() == Qt::Key_Shift &&
      !event->isAutoRepeat()) {
     shiftRecording = true;
+    worker->setRecording(recording || shiftRecording);
     printf("Started recording with shift...\n");
   }
+  CaptureConfig &config = configStore.edit();
   if(event->key() == Qt::Key_S &&
      event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
-    mouseSnap = !mouseSnap;
-    mouseSnapLabel->setText("Mouse pixel snap (ctrl+alt+s): " + QString(mouseSnap?"true":"false"));
+    config.mouseSnap = !config.mouseSnap;
+    mouseSnapLabel->setText("Mouse pixel snap (ctrl+alt+s): " + QString(config.mouseSnap?"true":"false"));
+    configStore.publish();
   }
   if(event->key() == Qt::Key_X &&
      event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
-    lockX = !lockX;
-    lockXLabel->setText("Mouse X locked (ctrl+alt+x): " + QString(lockX?"true":"false"));
-    if(lockX) {
-      lockPosX = QCursor::pos().x();
+    config.lockX = !config.lockX;
+    lockXLabel->setText("Mouse X locked (ctrl+alt+x): " + QString(config.lockX?"true":"false"));
+    if(config.lockX) {
+      config.lockPosX = QCursor::pos().x();
     }
+    configStore.publish();
   }
   if(event->key() == Qt::Key_Y &&
      event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
-    lockY = !lockY;
-    lockYLabel->setText("Mouse Y locked (ctrl+alt+y): " + QString(lockY?"true":"false"));
-    if(lockY) {
-      lockPosY = QCursor::pos().y();
+    config.lockY = !config.lockY;
+    lockYLabel->setText("Mouse Y locked (ctrl+alt+y): " + QString(config.lockY?"true":"false"));
+    if(config.lockY) {
+      config.lockPosY = QCursor::pos().y();
     }
+    configStore.publish();
+  }
+  if(event->key() == Qt::Key_R &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.roiCapture = !config.roiCapture;
+    roiLabel->setText("ROI recording (ctrl+alt+r): " + QString(config.roiCapture?"true":"false"));
+    settings.setValue("grab/roi", config.roiCapture);
+    configStore.publish();
+  }
+  if(event->key() == Qt::Key_A &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.adaptiveCapture = !config.adaptiveCapture;
+    adaptiveLabel->setText("Adaptive capture (ctrl+alt+a): " + QString(config.adaptiveCapture?"true":"false"));
+    settings.setValue("grab/adaptive", config.adaptiveCapture);
+    configStore.publish();
+  }
+  if(event->key() == Qt::Key_G &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.gridDetection = !config.gridDetection;
+    settings.setValue("viewport/detectGrid", config.gridDetection);
+    configStore.publish();
+    updateGridLabel();
+  }
+  if(event->key() == Qt::Key_P &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    const bool enabled = !Profiler::isEnabled();
+    Profiler::setEnabled(enabled);
+    settings.setValue("debug/profile", enabled);
+    profileLabel->setVisible(enabled);
+    if(enabled) {
+      profileTimer.start();
+    } else {
+      profileTimer.stop();
+    }
+    printf("Profiling %s\n", enabled?"enabled":"disabled");
+  }
+  if(event->key() == Qt::Key_T &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    const QString fileName = "trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+    if(Profiler::saveTrace(fileName)) {
+      printf("Saved trace to '%s'\n", qPrintable(fileName));
+    } else {
+      printf("The trace could not be written to '%s'\n", qPrintable(fileName));
+    }
+  }
+  if(event->key() == Qt::Key_M &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.motionCompensation = !config.motionCompensation;
+    settings.setValue("grab/motion", config.motionCompensation);
+    configStore.publish();
+    updateMotionLabel();
+  }
+  if(event->key() == Qt::Key_D &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.dither = (CaptureConfig::Dither)((config.dither + 1) % 3);
+    settings.setValue("post/dither", config.dither == CaptureConfig::OrderedDither?"ordered":
+                                     config.dither == CaptureConfig::FloydSteinberg?"floyd-steinberg":"none");
+    configStore.publish();
+    updateDitherLabel();
+  }
+  if(event->key() == Qt::Key_L &&
+     event->modifiers() == (Qt::ControlModifier | Qt::AltModifier)) {
+    config.streamEnabled = !config.streamEnabled;
+    streamLabel->setText("LED streaming (ctrl+alt+l): " + QString(config.streamEnabled?"true":"false"));
+    settings.setValue("stream/enabled", config.streamEnabled);
+    configStore.publish();
   }
 }
 
@@ -284,16 +705,29 @@ void Window::keyReleaseEvent(QKeyEvent *event)
   if(event->key() == Qt::Key_Shift &&
      !event->isAutoRepeat()) {
     shiftRecording = false;
+    worker->setRecording(recording || shiftRecording);
     printf("Ended recording with shift...\n");
   }
 }
 
 void Window::clearFrames()
 {
-  if(QMessageBox::question(this, tr("Clear all frames?"),
-                           tr("Are you sure you want to clear all grabbed frames?"),
+  QString question = tr("Are you sure you want to clear all grabbed frames?");
+  if(settings.value("journal/enabled", true).toBool()) {
+    question += " " + tr("They are kept in 'session.rgj.bak' in the journal folder until the next clear.");
+  }
+  if(QMessageBox::question(this, tr("Clear all frames?"), question,
                            QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-    frames.clear();
-    frameStatusLabel->setText("0 / 0");
+    // Clears the frames and picks up a changed pixel format for the next take
+    frames.setPixelFormat(FrameStore::pixelFormatFromName(settings.value("grab/pixelFormat", "rgb888").toString()));
+    for(auto *regionStore: regionFrames) {
+      regionStore->setPixelFormat(frames.pixelFormat());
+    }
+    exporter->clearStaging();
+    frameIdx = 0;
+    holdTick = 0;
+    worker->recordQueue.resetDropped();
+    worker->resetSkippedTicks();
+    updateFrameStatus();
   }
 }
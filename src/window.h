@@ -28,14 +28,33 @@
 #define __WINDOW_H__
 
 #include "slider.h"
+#include "previewwidget.h"
+#include "captureworker.h"
+#include "captureconfig.h"
+#include "exporter.h"
+#include "framestore.h"
+#include "ledanimation.h"
+#include "postprocess.h"
+#include "profiler.h"
 
 #include <QWidget>
 #include <QLabel>
 #include <QSettings>
 #include <QPushButton>
-#include <QBasicTimer>
 #include <QTimer>
+#include <QThread>
 #include <QKeyEvent>
+#include <QFutureWatcher>
+
+// One store of an LED animation export, written in the background
+struct AnimationJob
+{
+  // A snapshot, so recording can carry on while the export runs
+  FrameStore frames;
+  QVector<int> durations;
+  QString fileName;
+  bool saved = false;
+};
 
 class Window : public QWidget
 {
@@ -48,7 +67,6 @@ class Window : public QWidget
 public slots:
   
 protected:
-  void timerEvent(QTimerEvent *event);
   void keyPressEvent(QKeyEvent *event);
   void keyReleaseEvent(QKeyEvent *event);
 
@@ -56,31 +74,66 @@ private slots:
   void initRecording();
   void startRecording();
   void exportFrames();
-  void setFps(int fps);
+  void exportAnimation();
+  void animationFinished();
+  void openAnimation();
   void clearFrames();
+  void consumeFrames();
+  void detectGrid();
 
 private:
+  QVector<int> exportHolds();
+  QVector<int> regionHolds(const int &idx);
+  int exportFps();
+  void bindSlider(Slider *slider, int CaptureConfig::*member);
+  void updateFrameStatus();
+  void updateMotionLabel();
+  void updateDitherLabel();
+  void updateGridLabel();
+  void updateProfile();
+  void applyGrid(const PixelGrid &grid);
   QSettings &settings;
+  CaptureConfigStore configStore;
   bool recording = false;
   bool shiftRecording = false;
   QTimer delayTimer;
-  QLabel *viewport = nullptr;
-  QLabel *grabbed = nullptr;
+  PreviewWidget *viewport = nullptr;
+  PreviewWidget *grabbed = nullptr;
   QLabel *mouseSnapLabel = nullptr;
   QLabel *lockXLabel = nullptr;
   QLabel *lockYLabel = nullptr;
+  QLabel *roiLabel = nullptr;
+  QLabel *adaptiveLabel = nullptr;
+  QLabel *motionLabel = nullptr;
+  QLabel *streamLabel = nullptr;
+  QLabel *ditherLabel = nullptr;
+  QLabel *gridLabel = nullptr;
+  QLabel *profileLabel = nullptr;
+  QTimer profileTimer;
+  Slider *viewportDividerSlider = nullptr;
+  Slider *snapAlignmentXSlider = nullptr;
+  Slider *snapAlignmentYSlider = nullptr;
+  // The latest grid detection result. A one-shot detection is applied right
+  // away, continuous detection waits for the same grid twice in a row
+  PixelGrid lastGrid;
+  bool hasGridResult = false;
+  bool gridOneShot = false;
   QLabel *frameStatusLabel = nullptr;
   QPushButton *recordButton = nullptr;
-  QBasicTimer grabTimer;
+  QThread captureThread;
+  CursorTracker *cursorTracker = nullptr;
+  CaptureWorker *worker = nullptr;
+  Exporter *exporter = nullptr;
+  QVector<AnimationJob> animationJobs;
+  QFutureWatcher<void> animationWatcher;
   int frameIdx = 0;
-  QList<QPixmap> frames;
-  QVector<QPixmap> backBufferPixmap;
-  QVector<QPoint> backBufferMouse;
-  bool lockX = false;
-  bool lockY = false;
-  bool mouseSnap = true;
-  int lockPosX = -1;
-  int lockPosY = -1;
+  int holdTick = 0;
+  FrameStore frames;
+  PostProcess postProcess;
+  QImage correctedFrame;
+  // One per capture region, in the order of the config. Regions are fixed
+  // for the lifetime of the window
+  QVector<FrameStore *> regionFrames;
   
 };
 
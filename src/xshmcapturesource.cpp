@@ -0,0 +1,154 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            xshmcapturesource.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "xshmcapturesource.h"
+
+#include <QPainter>
+
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+XShmCaptureSource::XShmCaptureSource(const ScreenInfo &)
+{
+  // A connection of our own, the one used by Qt belongs to the GUI thread
+  int screenNumber = 0;
+  connection = xcb_connect(nullptr, &screenNumber);
+  if(xcb_connection_has_error(connection)) {
+    xcb_disconnect(connection);
+    connection = nullptr;
+    return;
+  }
+  const xcb_query_extension_reply_t *shm = xcb_get_extension_data(connection, &xcb_shm_id);
+  if(shm == nullptr || !shm->present) {
+    xcb_disconnect(connection);
+    connection = nullptr;
+    return;
+  }
+  xcb_screen_iterator_t screens = xcb_setup_roots_iterator(xcb_get_setup(connection));
+  for(int idx = 0; idx < screenNumber && screens.rem > 0; ++idx) {
+    xcb_screen_next(&screens);
+  }
+  // Only 24 and 32 bit true color roots map directly onto QImage::Format_RGB32
+  if(screens.rem == 0 || (screens.data->root_depth != 24 && screens.data->root_depth != 32)) {
+    xcb_disconnect(connection);
+    connection = nullptr;
+    return;
+  }
+  root = screens.data->root;
+  rootRect = QRect(0, 0, screens.data->width_in_pixels, screens.data->height_in_pixels);
+}
+
+XShmCaptureSource::~XShmCaptureSource()
+{
+  release();
+  if(connection != nullptr) {
+    xcb_disconnect(connection);
+  }
+}
+
+bool XShmCaptureSource::isValid() const
+{
+  return connection != nullptr;
+}
+
+bool XShmCaptureSource::reserve(const int &bytes)
+{
+  if(bytes <= shmBytes) {
+    return true;
+  }
+  release();
+  // Grow in 1 MiB steps so a slowly growing viewport doesn't reallocate the
+  // segment on every tick
+  const int size = ((bytes >> 20) + 1) << 20;
+  shmId = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if(shmId == -1) {
+    return false;
+  }
+  shmData = (uchar *)shmat(shmId, nullptr, 0);
+  if(shmData == (uchar *)-1) {
+    shmData = nullptr;
+    shmctl(shmId, IPC_RMID, nullptr);
+    shmId = -1;
+    return false;
+  }
+  segment = xcb_generate_id(connection);
+  xcb_generic_error_t *error = xcb_request_check(connection, xcb_shm_attach_checked(connection, segment, shmId, 0));
+  // Marked for removal right away, it is freed once both sides detach
+  shmctl(shmId, IPC_RMID, nullptr);
+  if(error != nullptr) {
+    free(error);
+    shmdt(shmData);
+    shmData = nullptr;
+    shmId = -1;
+    return false;
+  }
+  shmBytes = size;
+  return true;
+}
+
+void XShmCaptureSource::release()
+{
+  if(shmData != nullptr) {
+    xcb_shm_detach(connection, segment);
+    xcb_flush(connection);
+    shmdt(shmData);
+    shmData = nullptr;
+  }
+  shmId = -1;
+  shmBytes = 0;
+}
+
+bool XShmCaptureSource::grab(const ScreenInfo &, const QRect &rect, QImage &image)
+{
+  // X refuses to read outside of the root window, so only the visible part is
+  // grabbed and the rest is left black
+  const QRect visible = rect.intersected(rootRect);
+  if(connection == nullptr || visible.isEmpty() ||
+     !reserve(visible.width() * visible.height() * 4)) {
+    return false;
+  }
+  xcb_shm_get_image_reply_t *reply =
+    xcb_shm_get_image_reply(connection,
+                            xcb_shm_get_image(connection, root,
+                                              visible.x(), visible.y(), visible.width(), visible.height(),
+                                              ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, segment, 0),
+                            nullptr);
+  if(reply == nullptr) {
+    return false;
+  }
+  free(reply);
+  const QImage shared(shmData, visible.width(), visible.height(), visible.width() * 4, QImage::Format_RGB32);
+  if(visible == rect) {
+    image = shared;
+  } else {
+    image = QImage(rect.size(), QImage::Format_RGB32);
+    image.fill(Qt::black);
+    QPainter painter(&image);
+    painter.drawImage(visible.topLeft() - rect.topLeft(), shared);
+  }
+  return true;
+}
@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            xshmcapturesource.h
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef __XSHMCAPTURESOURCE_H__
+#define __XSHMCAPTURESOURCE_H__
+
+#include "capturesource.h"
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+
+// Grabs from the X root window through one MIT-SHM segment that is reused for
+// every grab. The image handed out wraps the segment directly, so there is no
+// copy on the client side
+class XShmCaptureSource : public CaptureSource
+{
+public:
+  XShmCaptureSource(const ScreenInfo &screen);
+  ~XShmCaptureSource();
+  bool isValid() const;
+  bool grab(const ScreenInfo &screen, const QRect &rect, QImage &image) override;
+
+private:
+  bool reserve(const int &bytes);
+  void release();
+  xcb_connection_t *connection = nullptr;
+  xcb_window_t root = 0;
+  QRect rootRect;
+  xcb_shm_seg_t segment = 0;
+  int shmId = -1;
+  uchar *shmData = nullptr;
+  int shmBytes = 0;
+
+};
+
+#endif // __XSHMCAPTURESOURCE_H__
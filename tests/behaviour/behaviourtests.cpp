@@ -0,0 +1,552 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            behaviourtests.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "framestore.h"
+#include "ledanimation.h"
+#include "animatedexport.h"
+#include "ledstreamer.h"
+#include "captureconfig.h"
+#include "griddetector.h"
+
+#include <QtTest>
+#include <QImage>
+#include <QImageReader>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <QThread>
+
+#include <string.h>
+
+namespace
+{
+  QImage noise(const int &width, const int &height, const quint32 &seed)
+  {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = seed;
+    for(int y = 0; y < height; ++y) {
+      QRgb *line = (QRgb *)image.scanLine(y);
+      for(int x = 0; x < width; ++x) {
+        state = (state * 1664525u) + 1013904223u;
+        line[x] = 0xff000000 | (state >> 8);
+      }
+    }
+    return image;
+  }
+
+  // Two colors only, so the animated formats can reproduce the frames
+  // exactly. The block moves so every frame changes only part of the image
+  QImage sprite(const int &idx)
+  {
+    QImage image(32, 24, QImage::Format_RGB32);
+    image.fill(qRgb(16, 32, 64));
+    QPainter painter(&image);
+    painter.fillRect((idx * 6) % 28, 4 + ((idx * 4) % 16), 4, 4, QColor(240, 200, 8));
+    painter.end();
+    return image;
+  }
+
+  bool sameFrame(const FrameStore &a, const int &aIdx, const FrameStore &b, const int &bIdx)
+  {
+    return a.frameBytes() == b.frameBytes() &&
+      memcmp(a.frameData(aIdx), b.frameData(bIdx), a.frameBytes()) == 0;
+  }
+
+  quint32 crc32(const QByteArray &data)
+  {
+    quint32 crc = 0xffffffffu;
+    for(const char byte: data) {
+      crc ^= (uchar)byte;
+      for(int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+      }
+    }
+    return crc ^ 0xffffffffu;
+  }
+
+  void putChunk(QByteArray &png, const QByteArray &type, const QByteArray &content)
+  {
+    uchar length[4];
+    qToBigEndian<quint32>(content.size(), length);
+    png.append((const char *)length, 4);
+    png.append(type + content);
+    uchar crc[4];
+    qToBigEndian<quint32>(crc32(type + content), crc);
+    png.append((const char *)crc, 4);
+  }
+
+  struct ApngFrame
+  {
+    QImage image;
+    int delayMs = 0;
+  };
+
+  // A minimal APNG decoder, enough for what AnimatedExport writes: every
+  // CRC is checked, and each frame is decoded as a PNG of its own and drawn
+  // over the previous one
+  bool decodeApng(const QByteArray &png, QVector<ApngFrame> &frames)
+  {
+    if(!png.startsWith(QByteArray("\x89PNG\r\n\x1a\n", 8))) {
+      return false;
+    }
+    QByteArray header;
+    QByteArray palette;
+    int frameCount = -1;
+    quint32 sequence = 0;
+    QImage canvas;
+    QRect rect;
+    int offset = 8;
+    while(offset + 12 <= png.size()) {
+      const qint64 length = qFromBigEndian<quint32>(png.constData() + offset);
+      if(offset + 12 + length > png.size()) {
+        return false;
+      }
+      const QByteArray type = png.mid(offset + 4, 4);
+      const QByteArray content = png.mid(offset + 8, length);
+      if(qFromBigEndian<quint32>(png.constData() + offset + 8 + length) != crc32(type + content)) {
+        return false;
+      }
+      offset += 12 + length;
+      if(type == "IHDR") {
+        header = content;
+        canvas = QImage(qFromBigEndian<quint32>(content.constData()), qFromBigEndian<quint32>(content.constData() + 4),
+                        QImage::Format_RGB32);
+      } else if(type == "PLTE") {
+        palette = content;
+      } else if(type == "acTL") {
+        frameCount = qFromBigEndian<quint32>(content.constData());
+      } else if(type == "fcTL") {
+        if(qFromBigEndian<quint32>(content.constData()) != sequence++) {
+          return false;
+        }
+        rect = QRect(qFromBigEndian<quint32>(content.constData() + 12), qFromBigEndian<quint32>(content.constData() + 16),
+                     qFromBigEndian<quint32>(content.constData() + 4), qFromBigEndian<quint32>(content.constData() + 8));
+        ApngFrame frame;
+        frame.delayMs = (qFromBigEndian<quint16>(content.constData() + 20) * 1000) /
+          qMax<quint16>(1, qFromBigEndian<quint16>(content.constData() + 22));
+        frames.append(frame);
+      } else if(type == "IDAT" || type == "fdAT") {
+        QByteArray data = content;
+        if(type == "fdAT") {
+          if(qFromBigEndian<quint32>(content.constData()) != sequence++) {
+            return false;
+          }
+          data = content.mid(4);
+        }
+        if(frames.isEmpty() || header.size() != 13) {
+          return false;
+        }
+        QByteArray partHeader = header;
+        qToBigEndian<quint32>(rect.width(), (uchar *)partHeader.data());
+        qToBigEndian<quint32>(rect.height(), (uchar *)partHeader.data() + 4);
+        QByteArray part("\x89PNG\r\n\x1a\n", 8);
+        putChunk(part, "IHDR", partHeader);
+        putChunk(part, "PLTE", palette);
+        putChunk(part, "IDAT", data);
+        putChunk(part, "IEND", QByteArray());
+        const QImage image = QImage::fromData(part, "PNG");
+        if(image.size() != rect.size()) {
+          return false;
+        }
+        QPainter painter(&canvas);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(rect.topLeft(), image);
+        painter.end();
+        frames.last().image = canvas.copy();
+      }
+    }
+    return offset == png.size() && frameCount == frames.count();
+  }
+}
+
+// Round trips and wire formats, checked for their exact results
+class BehaviourTests : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void deduplicate();
+  void holdsAt();
+  void rglaRoundTrip_data();
+  void rglaRoundTrip();
+  void rglaLongFrames();
+  void gifDecode();
+  void apngDecode();
+  void journalReopen();
+  void streamPackets_data();
+  void streamPackets();
+  void gridSparse_data();
+  void gridSparse();
+
+private:
+  void animatedStore(FrameStore &store, QVector<int> &durations) const;
+  QTemporaryDir dir;
+};
+
+void BehaviourTests::initTestCase()
+{
+  QVERIFY(dir.isValid());
+}
+
+void BehaviourTests::deduplicate()
+{
+  const QImage a = noise(16, 16, 1);
+  const QImage b = noise(16, 16, 2);
+  FrameStore store;
+  store.setDeduplicate(true);
+  QCOMPARE(store.append(a), FrameStore::Appended);
+  QCOMPARE(store.append(a), FrameStore::Held);
+  QCOMPARE(store.append(b), FrameStore::Appended);
+  QCOMPARE(store.append(a, -1, 2), FrameStore::Appended);
+  QCOMPARE(store.count(), 3);
+  QCOMPARE(store.totalTicks(), 5);
+  QCOMPARE(store.hold(0), 2);
+  QCOMPARE(store.hold(1), 1);
+  QCOMPARE(store.hold(2), 2);
+  QVERIFY(sameFrame(store, 0, store, 2));
+  QCOMPARE(store.frame(1).convertToFormat(QImage::Format_RGB32), b);
+
+  FrameStore plain;
+  QCOMPARE(plain.append(a), FrameStore::Appended);
+  QCOMPARE(plain.append(a), FrameStore::Appended);
+  QCOMPARE(plain.count(), 2);
+}
+
+void BehaviourTests::holdsAt()
+{
+  const qint64 tick = 1000000000LL / 30;
+  FrameStore store;
+  for(int idx = 0; idx < 4; ++idx) {
+    store.append(noise(8, 8, idx + 1), idx * tick);
+  }
+  QCOMPARE(store.holdsAt(0, 30), QVector<int>({1, 1, 1, 1}));
+  QCOMPARE(store.holdsAt(30, 30), QVector<int>({1, 1, 1, 1}));
+  // Half the rate drops every other frame
+  QCOMPARE(store.holdsAt(15, 30), QVector<int>({1, 0, 1, 0}));
+
+  // A held frame followed by a pause in recording keeps one extra tick
+  FrameStore paused;
+  paused.append(noise(8, 8, 1), 0);
+  paused.append(noise(8, 8, 2), 1000000000LL);
+  QCOMPARE(paused.holdsAt(30, 30), QVector<int>({2, 1}));
+
+  // Twice the rate doubles the holds
+  FrameStore held;
+  held.append(noise(8, 8, 1), 0, 2);
+  held.append(noise(8, 8, 2), 2 * tick);
+  held.append(noise(8, 8, 3), 3 * tick);
+  QCOMPARE(held.holdsAt(60, 30), QVector<int>({4, 2, 2}));
+}
+
+void BehaviourTests::rglaRoundTrip_data()
+{
+  QTest::addColumn<int>("format");
+  for(const auto format: {FrameStore::Rgb32, FrameStore::Rgb888, FrameStore::Rgb565, FrameStore::Rgb332}) {
+    QTest::newRow(qPrintable(FrameStore::pixelFormatName(format))) << (int)format;
+  }
+}
+
+void BehaviourTests::rglaRoundTrip()
+{
+  QFETCH(int, format);
+  FrameStore store((FrameStore::PixelFormat)format);
+  for(int idx = 0; idx < 6; ++idx) {
+    store.append(noise(24, 16, idx + 1), -1, (idx % 3) + 1);
+  }
+  const QString fileName = dir.filePath("roundtrip.rgla");
+  QVERIFY(LedAnimation::save(fileName, store, LedAnimation::durations(store.holdsAt(0, 30), 30)));
+
+  FrameStore loaded;
+  QVERIFY(LedAnimation::load(fileName, loaded, 1000 / 30));
+  QCOMPARE((int)loaded.pixelFormat(), format);
+  QCOMPARE(loaded.frameSize(), store.frameSize());
+  QCOMPARE(loaded.count(), store.count());
+  for(int idx = 0; idx < store.count(); ++idx) {
+    QVERIFY(sameFrame(store, idx, loaded, idx));
+    QCOMPARE(loaded.hold(idx), store.hold(idx));
+  }
+}
+
+void BehaviourTests::rglaLongFrames()
+{
+  FrameStore store;
+  for(int idx = 0; idx < 4; ++idx) {
+    store.append(noise(8, 8, idx + 1));
+  }
+  // Frames with no duration are left out, longer than 16 bits are split
+  const QString fileName = dir.filePath("long.rgla");
+  QVERIFY(LedAnimation::save(fileName, store, {40, 70000, 0, 40}));
+
+  FrameStore loaded;
+  QVERIFY(LedAnimation::load(fileName, loaded, 1));
+  QCOMPARE(loaded.count(), 4);
+  QVERIFY(sameFrame(store, 0, loaded, 0));
+  QVERIFY(sameFrame(store, 1, loaded, 1));
+  QVERIFY(sameFrame(store, 1, loaded, 2));
+  QVERIFY(sameFrame(store, 3, loaded, 3));
+  QCOMPARE(loaded.hold(0), 40);
+  QCOMPARE(loaded.hold(1), 65535);
+  QCOMPARE(loaded.hold(2), 70000 - 65535);
+  QCOMPARE(loaded.hold(3), 40);
+}
+
+void BehaviourTests::animatedStore(FrameStore &store, QVector<int> &durations) const
+{
+  // The third frame repeats the second, so it only extends its delay
+  for(const int idx: {0, 1, 1, 2}) {
+    store.append(sprite(idx));
+    durations.append(40);
+  }
+}
+
+void BehaviourTests::gifDecode()
+{
+  if(!QImageReader::supportedImageFormats().contains("gif")) {
+    QSKIP("Qt was built without GIF support");
+  }
+  FrameStore store;
+  QVector<int> durations;
+  animatedStore(store, durations);
+  const QString fileName = dir.filePath("animation.gif");
+  QVERIFY(AnimatedExport::saveGif(fileName, store, durations));
+
+  QImageReader reader(fileName, "gif");
+  QCOMPARE(reader.imageCount(), 3);
+  int totalDelay = 0;
+  for(const int idx: {0, 1, 3}) {
+    const QImage image = reader.read();
+    QVERIFY2(!image.isNull(), qPrintable(reader.errorString()));
+    QCOMPARE(image.convertToFormat(QImage::Format_RGB32), store.frame(idx).convertToFormat(QImage::Format_RGB32));
+    totalDelay += reader.nextImageDelay();
+  }
+  QCOMPARE(totalDelay, 160);
+}
+
+void BehaviourTests::apngDecode()
+{
+  FrameStore store;
+  QVector<int> durations;
+  animatedStore(store, durations);
+  const QString fileName = dir.filePath("animation.png");
+  QVERIFY(AnimatedExport::saveApng(fileName, store, durations));
+
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+  const QByteArray png = file.readAll();
+  QVector<ApngFrame> frames;
+  QVERIFY(decodeApng(png, frames));
+  QCOMPARE(frames.count(), 3);
+  const int expected[] = {0, 1, 3};
+  const int delays[] = {40, 80, 40};
+  for(int idx = 0; idx < frames.count(); ++idx) {
+    QCOMPARE(frames.at(idx).image, store.frame(expected[idx]).convertToFormat(QImage::Format_RGB32));
+    QCOMPARE(frames.at(idx).delayMs, delays[idx]);
+  }
+  // Players without APNG support show the first frame
+  QCOMPARE(QImage::fromData(png, "PNG").convertToFormat(QImage::Format_RGB32), frames.first().image);
+}
+
+void BehaviourTests::journalReopen()
+{
+  // 256 KiB frames, so a 4 MiB block holds 16 of them and the budget keeps
+  // only about one block in memory
+  const QString fileName = dir.filePath("session.rgj");
+  const qint64 budget = 4 * 1024 * 1024;
+  const qint64 tick = 1000000000LL / 30;
+  QVector<QImage> images;
+  for(int idx = 0; idx < 64; ++idx) {
+    images.append(noise(256, 256, idx + 1));
+  }
+  QVector<int> holds;
+  QVector<qint64> timestamps;
+  {
+    FrameStore store(FrameStore::Rgb32);
+    store.setDeduplicate(true);
+    store.setJournal(fileName, budget);
+    int ticks = 0;
+    for(const auto &image: images) {
+      store.append(image, ticks * tick);
+      ticks++;
+      // Every fourth frame is held for a tick, which goes into the journal
+      // as a hold record
+      if(ticks % 4 == 0) {
+        QCOMPARE(store.append(image, ticks * tick), FrameStore::Held);
+        ticks++;
+      }
+      // Blocks are only dropped once the writer has caught up with them
+      QThread::msleep(2);
+    }
+    QVERIFY(!store.journalFailed());
+    QVERIFY(store.memoryUsage() < 64LL * store.frameBytes());
+    for(int idx = 0; idx < store.count(); ++idx) {
+      QCOMPARE(store.frame(idx), images.at(idx));
+      holds.append(store.hold(idx));
+      timestamps.append(store.timestamp(idx));
+    }
+  }
+
+  FrameStore reopened;
+  QVERIFY(reopened.reopenJournal(fileName, budget));
+  QCOMPARE((int)reopened.pixelFormat(), (int)FrameStore::Rgb32);
+  QCOMPARE(reopened.count(), images.count());
+  QVERIFY(reopened.memoryUsage() <= budget);
+  for(int idx = 0; idx < reopened.count(); ++idx) {
+    QCOMPARE(reopened.frame(idx), images.at(idx));
+    QCOMPARE(reopened.hold(idx), holds.at(idx));
+    QCOMPARE(reopened.timestamp(idx), timestamps.at(idx));
+  }
+  // Recording continues where the session left off
+  const QImage extra = noise(256, 256, 1000);
+  QCOMPARE(reopened.append(extra), FrameStore::Appended);
+  QCOMPARE(reopened.frame(images.count()), extra);
+}
+
+void BehaviourTests::streamPackets_data()
+{
+  QTest::addColumn<int>("protocol");
+  QTest::newRow("ddp") << (int)CaptureConfig::Ddp;
+  QTest::newRow("e131") << (int)CaptureConfig::E131;
+}
+
+void BehaviourTests::streamPackets()
+{
+  QFETCH(int, protocol);
+  QUdpSocket receiver;
+  QVERIFY(receiver.bind(QHostAddress::LocalHost, 0));
+  CaptureConfig config;
+  config.streamEnabled = true;
+  config.streamProtocol = (CaptureConfig::StreamProtocol)protocol;
+  config.streamHost = "127.0.0.1";
+  config.streamPort = receiver.localPort();
+  config.streamUniverse = 7;
+  // 2400 bytes of RGB, split over two DDP packets or five universes
+  const QImage frame = noise(40, 20, 3);
+  QByteArray rgb;
+  for(int y = 0; y < frame.height(); ++y) {
+    for(int x = 0; x < frame.width(); ++x) {
+      const QRgb pixel = frame.pixel(x, y);
+      rgb.append((char)qRed(pixel));
+      rgb.append((char)qGreen(pixel));
+      rgb.append((char)qBlue(pixel));
+    }
+  }
+  LedStreamer streamer;
+  streamer.configure(config);
+  streamer.send(frame);
+
+  const int expected = protocol == CaptureConfig::Ddp?2:5;
+  QVector<QByteArray> packets;
+  while(packets.count() < expected && receiver.waitForReadyRead(2000)) {
+    while(receiver.hasPendingDatagrams()) {
+      QByteArray packet(receiver.pendingDatagramSize(), '\0');
+      receiver.readDatagram(packet.data(), packet.size());
+      packets.append(packet);
+    }
+  }
+  QCOMPARE(packets.count(), expected);
+
+  QByteArray payload;
+  for(int idx = 0; idx < packets.count(); ++idx) {
+    const QByteArray &packet = packets.at(idx);
+    const uchar *data = (const uchar *)packet.constData();
+    if(protocol == CaptureConfig::Ddp) {
+      const bool last = idx == packets.count() - 1;
+      QCOMPARE((int)data[0], 0x40 | (last?0x01:0x00));
+      QCOMPARE((int)data[1], 1);
+      QCOMPARE((int)data[2], 0x0b);
+      QCOMPARE((int)data[3], 0x01);
+      QCOMPARE((int)qFromBigEndian<quint32>(data + 4), payload.size());
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 8), packet.size() - 10);
+      QCOMPARE(packet.size() - 10, last?960:1440);
+      payload.append(packet.mid(10));
+    } else {
+      const int slots = idx == packets.count() - 1?360:510;
+      QCOMPARE(packet.size(), 126 + slots);
+      QCOMPARE((int)qFromBigEndian<quint16>(data), 0x0010);
+      QCOMPARE(packet.mid(4, 12), QByteArray("ASC-E1.17\0\0\0", 12));
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 16), 0x7000 | (packet.size() - 16));
+      QCOMPARE(qFromBigEndian<quint32>(data + 18), 0x00000004u);
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 38), 0x7000 | (packet.size() - 38));
+      QCOMPARE(qFromBigEndian<quint32>(data + 40), 0x00000002u);
+      QCOMPARE(QByteArray((const char *)data + 44), QByteArray("RetroGrab"));
+      QCOMPARE((int)data[108], 100);
+      QCOMPARE((int)data[111], 1);
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 113), 7 + idx);
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 115), 0x7000 | (packet.size() - 115));
+      QCOMPARE((int)data[117], 0x02);
+      QCOMPARE((int)data[118], 0xa1);
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 121), 1);
+      QCOMPARE((int)qFromBigEndian<quint16>(data + 123), slots + 1);
+      QCOMPARE((int)data[125], 0);
+      payload.append(packet.mid(126));
+    }
+  }
+  QCOMPARE(payload, rgb);
+}
+
+void BehaviourTests::gridSparse_data()
+{
+  QTest::addColumn<int>("scale");
+  QTest::addColumn<int>("cut");
+  QTest::newRow("scale 2") << 2 << 1;
+  QTest::newRow("scale 3") << 3 << 0;
+  QTest::newRow("scale 3 shifted") << 3 << 2;
+  QTest::newRow("scale 4") << 4 << 1;
+  QTest::newRow("scale 6") << 6 << 0;
+}
+
+void BehaviourTests::gridSparse()
+{
+  QFETCH(int, scale);
+  QFETCH(int, cut);
+  // A few 8x8 sprites on 8 pixel tiles with a single pixel detail each. Almost
+  // all edges fall on a grid of twice the scale, only the details don't
+  QImage source(96, 64, QImage::Format_RGB32);
+  source.fill(qRgb(0, 0, 0));
+  for(const auto &tile: {QPoint(0, 0), QPoint(16, 8), QPoint(40, 24), QPoint(64, 40), QPoint(80, 8), QPoint(24, 48)}) {
+    for(int y = 0; y < 8; ++y) {
+      for(int x = 0; x < 8; ++x) {
+        source.setPixel(tile.x() + x, tile.y() + y, qRgb(200, 80, 40));
+      }
+    }
+    source.setPixel(tile.x() + 5, tile.y() + 3, qRgb(255, 255, 255));
+  }
+  const QImage upscaled = source.scaled(source.size() * scale);
+  const QImage grab = upscaled.copy(cut, cut, upscaled.width() - cut, upscaled.height() - cut);
+  GridDetector detector;
+  PixelGrid grid;
+  QVERIFY(detector.detect(grab, grid));
+  QCOMPARE(grid.scale, scale);
+  const int phase = (scale - (cut % scale)) % scale;
+  QVERIFY(grid.hasPhaseX && grid.hasPhaseY);
+  QCOMPARE(QPoint(grid.phaseX, grid.phaseY), QPoint(phase, phase));
+}
+
+QTEST_GUILESS_MAIN(BehaviourTests)
+
+#include "behaviourtests.moc"
@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = pipelinebenchmark
+CONFIG += testcase console release
+CONFIG -= app_bundle
+QT += testlib
+
+include(../../src/src.pri)
+
+# Input
+SOURCES += pipelinebenchmark.cpp
@@ -0,0 +1,510 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            pipelinebenchmark.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include "downscale.h"
+#include "motionestimator.h"
+#include "griddetector.h"
+#include "capturepipeline.h"
+#include "framestore.h"
+#include "ledanimation.h"
+#include "animatedexport.h"
+#include "previewwidget.h"
+#include "postprocess.h"
+
+#include <stddef.h>
+#include <atomic>
+#include <QtTest>
+#include <QApplication>
+#include <QImage>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+namespace
+{
+  std::atomic<bool> countAllocations{false};
+  std::atomic<quint64> allocations{0};
+}
+
+#ifdef __GLIBC__
+// Every heap allocation of the process, Qt's and the C++ runtime's included,
+// ends up here. This only goes into the benchmark, never into RetroGrab itself.
+// Counting is off outside of the measured calls
+extern "C"
+{
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t count, size_t size);
+  void *__libc_realloc(void *pointer, size_t size);
+
+  void *malloc(size_t size) noexcept
+  {
+    if(countAllocations.load(std::memory_order_relaxed)) {
+      allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t count, size_t size) noexcept
+  {
+    if(countAllocations.load(std::memory_order_relaxed)) {
+      allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_calloc(count, size);
+  }
+
+  void *realloc(void *pointer, size_t size) noexcept
+  {
+    if(countAllocations.load(std::memory_order_relaxed)) {
+      allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+  }
+}
+#define ALLOCATIONS_COUNTED true
+#else
+#define ALLOCATIONS_COUNTED false
+#endif
+
+namespace
+{
+  // Times and counts the heap allocations of the calls made inside a
+  // QBENCHMARK loop, so frames per second and allocations per frame can be
+  // reported next to QtTest's own result
+  class FrameRate
+  {
+  public:
+    FrameRate(const int &framesPerCall = 1)
+      : framesPerCall(framesPerCall)
+    {
+      allocations = 0;
+    }
+
+    template <typename Function>
+    void run(const Function &function)
+    {
+      timer.start();
+      countAllocations = true;
+      function();
+      countAllocations = false;
+      nsecs += timer.nsecsElapsed();
+      calls++;
+    }
+
+    void report() const
+    {
+      const double frames = (double)calls * framesPerCall;
+      if(frames == 0.0) {
+        return;
+      }
+      const double framesPerSecond = frames * 1000000000.0 / qMax<qint64>(1, nsecs);
+      if(ALLOCATIONS_COUNTED) {
+        qInfo("%.0f frames/s, %.2f allocations per frame", framesPerSecond, allocations / frames);
+      } else {
+        qInfo("%.0f frames/s, allocations are only counted with glibc", framesPerSecond);
+      }
+    }
+
+  private:
+    int framesPerCall;
+    QElapsedTimer timer;
+    qint64 nsecs = 0;
+    qint64 calls = 0;
+  };
+
+  QImage noise(const int &width, const int &height)
+  {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = 1;
+    for(int y = 0; y < height; ++y) {
+      QRgb *line = (QRgb *)image.scanLine(y);
+      for(int x = 0; x < width; ++x) {
+        state = (state * 1664525u) + 1013904223u;
+        line[x] = 0xff000000 | (state >> 8);
+      }
+    }
+    return image;
+  }
+}
+
+// Timings of the capture pipeline kernels and stages on synthetic data. The
+// optimized kernels are also checked against their scalar reference
+class PipelineBenchmark : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void downscale_data();
+  void downscale();
+  void motion_data();
+  void motion();
+  void grid_data();
+  void grid();
+  void postProcess_data();
+  void postProcess();
+  void tick_data();
+  void tick();
+  void crop();
+  void append_data();
+  void append();
+  void preview();
+  void exportFormat_data();
+  void exportFormat();
+
+private:
+  // Distinct frames, so deduplication never kicks in
+  QVector<QImage> frames;
+  QTemporaryDir exportDir;
+};
+
+void PipelineBenchmark::initTestCase()
+{
+  const QImage strip = noise(64, 64 * 64);
+  for(int idx = 0; idx < 64; ++idx) {
+    frames.append(strip.copy(0, idx * 64, 64, 64));
+  }
+  QVERIFY(exportDir.isValid());
+}
+
+void PipelineBenchmark::downscale_data()
+{
+  QTest::addColumn<int>("factor");
+  QTest::addColumn<QString>("method");
+  for(const int factor: {1, 2, 3, 4, 6, 8, 16, 32}) {
+    for(const char *method: {"qt scaled", "qt paint", "nearest", "box scalar", "box sse2", "box avx2", "box best"}) {
+      QTest::addRow("%d %s", factor, method) << factor << QString(method);
+    }
+  }
+}
+
+void PipelineBenchmark::downscale()
+{
+  QFETCH(int, factor);
+  QFETCH(QString, method);
+  const int size = qMin(128, 2048 / factor);
+  const QImage source = noise(size * factor, size * factor);
+  QImage destination(size, size, QImage::Format_RGB32);
+  FrameRate rate;
+  if(method == "qt scaled") {
+    QBENCHMARK {
+      rate.run([&]() {
+        destination = source.scaledToWidth(size);
+      });
+    }
+  } else if(method == "qt paint") {
+    QBENCHMARK {
+      rate.run([&]() {
+        QPainter painter(&destination);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(destination.rect(), source);
+      });
+    }
+  } else if(method == "nearest") {
+    QBENCHMARK {
+      rate.run([&]() {
+        Downscale::scale(source, destination, factor, Downscale::Nearest);
+      });
+    }
+  } else {
+    const Downscale::InstructionSet instructionSet = method == "box scalar"?Downscale::Scalar:
+                                                     method == "box sse2"?Downscale::Sse2:
+                                                     method == "box avx2"?Downscale::Avx2:Downscale::Auto;
+    if(!Downscale::isSupported(instructionSet)) {
+      QSKIP("Not supported by this CPU");
+    }
+    QImage reference(size, size, QImage::Format_RGB32);
+    Downscale::scale(source, reference, factor, Downscale::Box, Downscale::Scalar);
+    QBENCHMARK {
+      rate.run([&]() {
+        Downscale::scale(source, destination, factor, Downscale::Box, instructionSet);
+      });
+    }
+    QVERIFY2(destination == reference, "Differs from the scalar reference");
+  }
+  rate.report();
+}
+
+void PipelineBenchmark::motion_data()
+{
+  QTest::addColumn<int>("radius");
+  for(const int radius: {4, 8, 16, 32}) {
+    QTest::addRow("radius %d", radius) << radius;
+  }
+}
+
+void PipelineBenchmark::motion()
+{
+  QFETCH(int, radius);
+  // A 64x64 region, the content moves right and up by a step inside the
+  // search window
+  const QImage noiseImage = noise(160, 160);
+  const QPoint shift(radius / 2, -radius / 4);
+  BackBufferSlot previous;
+  BackBufferSlot current;
+  previous.image = noiseImage.copy(16, 16, 128, 128);
+  current.image = noiseImage.copy(QRect(QPoint(16, 16) - shift, QSize(128, 128)));
+  MotionEstimator estimator;
+  QPoint motion;
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      estimator.estimate(previous, current, QRect(32, 32, 64, 64), radius, motion);
+    });
+  }
+  QCOMPARE(motion, shift);
+  rate.report();
+}
+
+void PipelineBenchmark::grid_data()
+{
+  QTest::addColumn<int>("scale");
+  for(const int scale: {2, 3, 4, 6, 8}) {
+    QTest::addRow("scale %d", scale) << scale;
+  }
+}
+
+void PipelineBenchmark::grid()
+{
+  QFETCH(int, scale);
+  // A 512x512 grab, upscaled without filtering and cut so the grid starts
+  // off the edge
+  const QImage noiseImage = noise(160, 160);
+  const QPoint phase(scale / 2, scale - 1);
+  const QImage upscaled = noiseImage.scaled(noiseImage.size() * scale);
+  const QImage grab = upscaled.copy(QRect(QPoint(scale, scale) - phase, QSize(512, 512)));
+  GridDetector detector;
+  PixelGrid grid;
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      detector.detect(grab, grid);
+    });
+  }
+  QVERIFY(grid.found);
+  QCOMPARE(grid.scale, scale);
+  QCOMPARE(QPoint(grid.phaseX, grid.phaseY), phase);
+  rate.report();
+}
+
+void PipelineBenchmark::postProcess_data()
+{
+  QTest::addColumn<int>("dither");
+  QTest::addColumn<int>("instructionSet");
+  const char *names[] = {"best", "scalar", "avx2"};
+  for(const auto instructionSet: {PostProcess::Auto, PostProcess::Scalar, PostProcess::Avx2}) {
+    QTest::addRow("none %s", names[instructionSet]) << (int)CaptureConfig::NoDither << (int)instructionSet;
+    QTest::addRow("ordered %s", names[instructionSet]) << (int)CaptureConfig::OrderedDither << (int)instructionSet;
+  }
+  QTest::addRow("floyd-steinberg") << (int)CaptureConfig::FloydSteinberg << (int)PostProcess::Scalar;
+}
+
+void PipelineBenchmark::postProcess()
+{
+  QFETCH(int, dither);
+  QFETCH(int, instructionSet);
+  if(!PostProcess::isSupported((PostProcess::InstructionSet)instructionSet)) {
+    QSKIP("Not supported by this CPU");
+  }
+  // Gamma and a 5-6-5 panel, so every channel goes through its tables
+  CaptureConfig config;
+  config.gamma = 22;
+  config.colorDepth = "565";
+  config.dither = (CaptureConfig::Dither)dither;
+  PostProcess postProcess;
+  postProcess.configure(config);
+  const QImage source = noise(128, 128);
+  QImage reference;
+  postProcess.apply(source, reference, PostProcess::Scalar);
+  QImage destination;
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      postProcess.apply(source, destination, (PostProcess::InstructionSet)instructionSet);
+    });
+  }
+  QVERIFY2(destination == reference, "Differs from the scalar reference");
+  rate.report();
+}
+
+void PipelineBenchmark::tick_data()
+{
+  QTest::addColumn<int>("divider");
+  QTest::addColumn<int>("mode");
+  for(const int divider: {1, 2, 4, 8}) {
+    QTest::addRow("divider %d nearest", divider) << divider << (int)Downscale::Nearest;
+    QTest::addRow("divider %d box", divider) << divider << (int)Downscale::Box;
+  }
+}
+
+void PipelineBenchmark::tick()
+{
+  QFETCH(int, divider);
+  QFETCH(int, mode);
+  // Full capture ticks, grab to look-ahead crop, of a 128x128 viewport on the
+  // synthetic screen
+  CaptureConfig config;
+  config.captureSource = "synthetic";
+  config.divider = divider;
+  config.grabWidth = 64;
+  config.grabHeight = 64;
+  config.downscaleMode = (Downscale::Mode)mode;
+  CapturePipeline pipeline;
+  QElapsedTimer clock;
+  clock.start();
+  CaptureTick result;
+  // The synthetic source doesn't need a screen
+  const ScreenInfo screen;
+  QVERIFY(pipeline.run(config, QPoint(512, 384), screen, clock, true, true, result));
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      pipeline.run(config, QPoint(512, 384), screen, clock, true, true, result);
+    });
+  }
+  rate.report();
+}
+
+void PipelineBenchmark::crop()
+{
+  // Only the look-ahead crop step, on a back buffer filled by full ticks of
+  // a 128x128 viewport
+  CaptureConfig config;
+  config.captureSource = "synthetic";
+  config.grabWidth = 64;
+  config.grabHeight = 64;
+  CapturePipeline pipeline;
+  QElapsedTimer clock;
+  clock.start();
+  CaptureTick result;
+  const ScreenInfo screen;
+  for(int idx = 0; idx <= config.backBuffer; ++idx) {
+    QVERIFY(pipeline.run(config, QPoint(512 + idx, 384), screen, clock, true, false, result));
+  }
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      result.hasCrop = false;
+      pipeline.cropOldest(config, QPoint(512 + config.backBuffer, 384), true, result);
+    });
+  }
+  QVERIFY(result.hasCrop);
+  QCOMPARE(result.crop.image.size(), QSize(64, 64));
+  rate.report();
+}
+
+void PipelineBenchmark::append_data()
+{
+  QTest::addColumn<int>("format");
+  for(const auto format: {FrameStore::Rgb32, FrameStore::Rgb888, FrameStore::Rgb565, FrameStore::Rgb332}) {
+    QTest::newRow(qPrintable(FrameStore::pixelFormatName(format))) << (int)format;
+  }
+}
+
+void PipelineBenchmark::append()
+{
+  QFETCH(int, format);
+  FrameStore store((FrameStore::PixelFormat)format);
+  int frameIdx = 0;
+  FrameRate rate;
+  QBENCHMARK {
+    if(store.count() >= 4096) {
+      store.clear();
+    }
+    rate.run([&]() {
+      store.append(frames.at(frameIdx++ % frames.count()));
+    });
+  }
+  rate.report();
+}
+
+void PipelineBenchmark::preview()
+{
+  PreviewWidget preview;
+  preview.resize(preview.sizeHint());
+  QImage target(256, 256, QImage::Format_RGB32);
+  int frameIdx = 0;
+  FrameRate rate;
+  QBENCHMARK {
+    rate.run([&]() {
+      preview.setFrame(frames.at(frameIdx++ % frames.count()));
+      preview.render(&target);
+    });
+  }
+  rate.report();
+}
+
+void PipelineBenchmark::exportFormat_data()
+{
+  QTest::addColumn<QString>("format");
+  for(const char *format: {"png", "rgla", "h", "gif", "apng"}) {
+    QTest::newRow(format) << QString(format);
+  }
+}
+
+void PipelineBenchmark::exportFormat()
+{
+  QFETCH(QString, format);
+  FrameStore store;
+  for(const auto &frame: frames) {
+    store.append(frame);
+  }
+  const QVector<int> durations = LedAnimation::durations(store.holdsAt(0, 30), 30);
+  const QString fileName = exportDir.filePath("animation." + format);
+  if(format == "png") {
+    int frameIdx = 0;
+    FrameRate rate;
+    QBENCHMARK {
+      rate.run([&]() {
+        store.frame(frameIdx++ % store.count()).save(fileName);
+      });
+    }
+    rate.report();
+  } else {
+    // The single file formats are written whole, the rate is per frame
+    FrameRate rate(store.count());
+    bool saved = false;
+    QBENCHMARK {
+      rate.run([&]() {
+        saved = LedAnimation::saveAs(format, fileName, store, durations);
+      });
+    }
+    QVERIFY(saved);
+    rate.report();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  // Works on synthetic screens and off-screen widgets, no display is needed
+  if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication app(argc, argv);
+  PipelineBenchmark benchmark;
+  return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "pipelinebenchmark.moc"
@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = ledreceiver
+DEPENDPATH += .
+INCLUDEPATH += .
+CONFIG += console
+CONFIG -= app_bundle
+QT = core network
+
+# Input
+SOURCES += main.cpp
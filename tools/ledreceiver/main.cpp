@@ -0,0 +1,288 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/***************************************************************************
+ *            main.cpp
+ *
+ *  Sat Oct 17 12:00:00 CEST 2026
+ *  Copyright 2026 Lars Muldjord
+ *  muldjordlars@gmail.com
+ ****************************************************************************/
+/*
+ *  This file is part of RetroGrab.
+ *
+ *  RetroGrab is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RetroGrab is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RetroGrab; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QUdpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QtEndian>
+#include <QtMath>
+
+// Receives the DDP or E1.31 packets sent by RetroGrab's LED streaming, checks
+// every header field and reports frame rate, jitter and (for DDP with
+// timecodes enabled) the send to receive latency on the same host
+
+struct Stats
+{
+  int packets = 0;
+  int frames = 0;
+  int errors = 0;
+  qint64 lastFrameNsecs = -1;
+  QVector<double> intervals;
+  QVector<double> latencies;
+};
+
+namespace
+{
+  Stats stats;
+  // Not 'clock', that would clash with ::clock() from <time.h>
+  QElapsedTimer receiveClock;
+}
+
+static void error(const QString &message)
+{
+  stats.errors++;
+  if(stats.errors <= 20) {
+    printf("error: %s\n", qPrintable(message));
+  }
+}
+
+static void frameComplete()
+{
+  const qint64 now = receiveClock.nsecsElapsed();
+  if(stats.lastFrameNsecs >= 0) {
+    stats.intervals.append((now - stats.lastFrameNsecs) / 1000000.0);
+  }
+  stats.lastFrameNsecs = now;
+  stats.frames++;
+}
+
+static double monotonicTimecodeMsecs(const quint32 &timecode)
+{
+  return ((timecode >> 16) * 1000.0) + ((timecode & 0xffff) * 1000.0 / 65536.0);
+}
+
+static void checkDdp(const QByteArray &datagram, const int &frameBytes)
+{
+  static int expectedOffset = 0;
+  static int frameSequence = -1;
+  const uchar *data = (const uchar *)datagram.constData();
+  if(datagram.size() < 10) {
+    error("DDP packet shorter than its header");
+    return;
+  }
+  const bool hasTimecode = data[0] & 0x10;
+  const int headerSize = hasTimecode?14:10;
+  const int sequence = data[1] & 0x0f;
+  const quint32 offset = qFromBigEndian<quint32>(data + 4);
+  const quint16 length = qFromBigEndian<quint16>(data + 8);
+  if((data[0] & 0xc0) != 0x40) {
+    error("DDP version is not 1");
+  }
+  if(data[2] != 0x0b) {
+    error(QString("DDP data type 0x%1 is not RGB24").arg(data[2], 2, 16, QChar('0')));
+  }
+  if(data[3] != 0x01) {
+    error(QString("DDP destination %1 is not the default display").arg(data[3]));
+  }
+  if(datagram.size() != headerSize + length) {
+    error(QString("DDP length %1 does not match the payload of %2 bytes").arg(length).arg(datagram.size() - headerSize));
+  }
+  if(length > 1440) {
+    error(QString("DDP payload of %1 bytes exceeds 1440").arg(length));
+  }
+  if(offset != (quint32)expectedOffset) {
+    error(QString("DDP offset %1, expected %2").arg(offset).arg(expectedOffset));
+  }
+  if(offset == 0) {
+    if(frameSequence != -1 && sequence != (frameSequence % 15) + 1) {
+      error(QString("DDP sequence %1 after %2").arg(sequence).arg(frameSequence));
+    }
+    frameSequence = sequence;
+  } else if(sequence != frameSequence) {
+    error("DDP sequence changed within a frame");
+  }
+  expectedOffset = offset + length;
+  if(data[0] & 0x01) {
+    if(frameBytes > 0 && expectedOffset != frameBytes) {
+      error(QString("DDP frame of %1 bytes, expected %2").arg(expectedOffset).arg(frameBytes));
+    }
+    if(hasTimecode) {
+      QElapsedTimer now;
+      now.start();
+      // The timecode only holds 16 bits of whole seconds, so it wraps
+      const double wrap = 65536.0 * 1000.0;
+      const double sent = monotonicTimecodeMsecs(qFromBigEndian<quint32>(data + 10));
+      const double received = fmod(now.msecsSinceReference(), wrap);
+      stats.latencies.append(fmod(received - sent + wrap, wrap));
+    }
+    expectedOffset = 0;
+    frameComplete();
+  }
+}
+
+static void checkE131(const QByteArray &datagram, const int &frameBytes, const int &firstUniverse)
+{
+  static int expectedUniverse = -1;
+  static int frameSequence = -1;
+  static int receivedBytes = 0;
+  const uchar *data = (const uchar *)datagram.constData();
+  if(datagram.size() < 126) {
+    error("E1.31 packet shorter than its header");
+    return;
+  }
+  const int size = datagram.size();
+  const int slotCount = qFromBigEndian<quint16>(data + 123) - 1;
+  const int universe = qFromBigEndian<quint16>(data + 113);
+  const int sequence = data[111];
+  if(qFromBigEndian<quint16>(data) != 0x0010 || qFromBigEndian<quint16>(data + 2) != 0x0000) {
+    error("E1.31 preamble or postamble size is wrong");
+  }
+  if(memcmp(data + 4, "ASC-E1.17\0\0\0", 12) != 0) {
+    error("E1.31 ACN packet identifier is wrong");
+  }
+  if(qFromBigEndian<quint16>(data + 16) != (0x7000 | (size - 16)) ||
+     qFromBigEndian<quint16>(data + 38) != (0x7000 | (size - 38)) ||
+     qFromBigEndian<quint16>(data + 115) != (0x7000 | (size - 115))) {
+    error("E1.31 flags and length fields do not match the packet size");
+  }
+  if(qFromBigEndian<quint32>(data + 18) != 0x00000004 ||
+     qFromBigEndian<quint32>(data + 40) != 0x00000002 ||
+     data[117] != 0x02) {
+    error("E1.31 root, framing or DMP vector is wrong");
+  }
+  if(data[118] != 0xa1 ||
+     qFromBigEndian<quint16>(data + 119) != 0x0000 ||
+     qFromBigEndian<quint16>(data + 121) != 0x0001 ||
+     data[125] != 0x00) {
+    error("E1.31 DMP address type, first address, increment or start code is wrong");
+  }
+  if(slotCount != size - 126 || slotCount > 512) {
+    error(QString("E1.31 property value count %1 does not match %2 slots").arg(slotCount + 1).arg(size - 126));
+  }
+  if(universe == firstUniverse) {
+    if(expectedUniverse != -1) {
+      error(QString("E1.31 frame restarted after %1 of %2 bytes").arg(receivedBytes).arg(frameBytes));
+    }
+    if(frameSequence != -1 && sequence != ((frameSequence + 1) & 0xff)) {
+      error(QString("E1.31 sequence %1 after %2").arg(sequence).arg(frameSequence));
+    }
+    frameSequence = sequence;
+    receivedBytes = 0;
+    expectedUniverse = firstUniverse;
+  }
+  if(universe != expectedUniverse) {
+    error(QString("E1.31 universe %1, expected %2").arg(universe).arg(expectedUniverse));
+    return;
+  }
+  if(sequence != frameSequence) {
+    error("E1.31 sequence changed within a frame");
+  }
+  receivedBytes += slotCount;
+  expectedUniverse++;
+  if(receivedBytes >= frameBytes) {
+    if(receivedBytes != frameBytes) {
+      error(QString("E1.31 frame of %1 bytes, expected %2").arg(receivedBytes).arg(frameBytes));
+    }
+    expectedUniverse = -1;
+    frameComplete();
+  }
+}
+
+static void printStats()
+{
+  printf("packets: %d, frames: %d, errors: %d\n", stats.packets, stats.frames, stats.errors);
+  if(!stats.intervals.isEmpty()) {
+    double sum = 0.0;
+    for(const auto &interval: stats.intervals) {
+      sum += interval;
+    }
+    const double mean = sum / stats.intervals.count();
+    double variance = 0.0;
+    for(const auto &interval: stats.intervals) {
+      variance += (interval - mean) * (interval - mean);
+    }
+    variance /= stats.intervals.count();
+    printf("frame interval: %.3f ms (%.2f fps), jitter: %.3f ms\n", mean, 1000.0 / mean, qSqrt(variance));
+  }
+  if(!stats.latencies.isEmpty()) {
+    QVector<double> sorted = stats.latencies;
+    std::sort(sorted.begin(), sorted.end());
+    printf("latency: min %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           sorted.first(), sorted.at(sorted.count() / 2),
+           sorted.at(qMin(sorted.count() - 1, (int)(sorted.count() * 0.99))), sorted.last());
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Validates DDP / E1.31 packets from RetroGrab's LED streaming");
+  parser.addHelpOption();
+  parser.addOption({"protocol", "ddp or e131.", "protocol", "ddp"});
+  parser.addOption({"port", "UDP port to listen on (default 4048 for DDP, 5568 for E1.31).", "port"});
+  parser.addOption({"width", "Expected frame width.", "pixels", "16"});
+  parser.addOption({"height", "Expected frame height.", "pixels", "16"});
+  parser.addOption({"universe", "First E1.31 universe.", "universe", "1"});
+  parser.addOption({"frames", "Exit after this many frames.", "count", "0"});
+  parser.addOption({"timeout", "Exit after this many seconds.", "seconds", "0"});
+  parser.process(app);
+
+  const bool isDdp = parser.value("protocol") != "e131";
+  const int port = parser.isSet("port")?parser.value("port").toInt():(isDdp?4048:5568);
+  const int frameBytes = parser.value("width").toInt() * parser.value("height").toInt() * 3;
+  const int firstUniverse = parser.value("universe").toInt();
+  const int maxFrames = parser.value("frames").toInt();
+
+  QUdpSocket socket;
+  if(!socket.bind(QHostAddress::Any, port)) {
+    printf("Could not bind to port %d: %s\n", port, qPrintable(socket.errorString()));
+    return 1;
+  }
+  printf("Listening for %s on port %d...\n", isDdp?"DDP":"E1.31", port);
+  receiveClock.start();
+
+  QObject::connect(&socket, &QUdpSocket::readyRead, [&]() {
+    while(socket.hasPendingDatagrams()) {
+      QByteArray datagram(socket.pendingDatagramSize(), '\0');
+      socket.readDatagram(datagram.data(), datagram.size());
+      stats.packets++;
+      if(isDdp) {
+        checkDdp(datagram, frameBytes);
+      } else {
+        checkE131(datagram, frameBytes, firstUniverse);
+      }
+      if(maxFrames > 0 && stats.frames >= maxFrames) {
+        app.quit();
+      }
+    }
+  });
+  if(parser.value("timeout").toInt() > 0) {
+    QTimer::singleShot(parser.value("timeout").toInt() * 1000, &app, &QCoreApplication::quit);
+  }
+  app.exec();
+
+  printStats();
+  return (stats.errors == 0 && stats.frames > 0)?0:1;
+}